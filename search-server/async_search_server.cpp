@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <exception>
+
+#include "async_search_server.h"
+
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t queue_capacity, ThreadPool& pool)
+    : AsyncSearchServer(
+        //Сервером не владеем - указатель без счётчика ссылок
+        [&search_server] { return std::shared_ptr<const SearchServer>(std::shared_ptr<const SearchServer>(), &search_server); },
+        queue_capacity, pool) {
+}
+
+AsyncSearchServer::AsyncSearchServer(const ConcurrentSearchServer& search_server, size_t queue_capacity, ThreadPool& pool)
+    : AsyncSearchServer([&search_server] { return search_server.GetVersion(); }, queue_capacity, pool) {
+}
+
+AsyncSearchServer::AsyncSearchServer(std::function<std::shared_ptr<const SearchServer>()> get_version,
+    size_t queue_capacity, ThreadPool& pool)
+    : get_version_(std::move(get_version))
+    , pool_(pool)
+    , queue_capacity_(std::max<size_t>(1, queue_capacity)) {
+}
+
+//Обработчики ссылаются на этот объект - дожидаемся их, выполняя задачи пула (деструктор может вызываться из потока пула)
+AsyncSearchServer::~AsyncSearchServer() {
+    std::unique_lock lock(mutex_);
+    while (runner_count_ > 0) {
+        lock.unlock();
+        const bool has_run = pool_.RunPendingTask();
+        lock.lock();
+        if (!has_run && runner_count_ > 0) {
+            runner_done_.wait(lock);
+        }
+    }
+}
+
+std::future<QueryResponse> AsyncSearchServer::SubmitQuery(std::string raw_query, Clock::time_point deadline,
+    DocumentStatus status, size_t max_result_count) {
+    std::promise<QueryResponse> promise;
+    std::future<QueryResponse> future = promise.get_future();
+    const Clock::time_point now = Clock::now();
+    bool needs_runner = false;
+    {
+        std::lock_guard guard(mutex_);
+        if (now >= deadline) {
+            promise.set_value({ QueryStatus::EXPIRED, {} });
+            Count(QueryStatus::EXPIRED);
+            return future;
+        }
+        if (queue_.size() >= queue_capacity_) {
+            DropExpired(now);
+        }
+        if (queue_.size() >= queue_capacity_) {
+            promise.set_value({ QueryStatus::REJECTED, {} });
+            Count(QueryStatus::REJECTED);
+            return future;
+        }
+        queue_.push_back({ std::move(raw_query), deadline, status, max_result_count, std::move(promise) });
+        //Работающие обработчики заберут запрос сами, новый нужен, только если заняты не все потоки пула
+        if (runner_count_ < pool_.GetWorkerCount()) {
+            ++runner_count_;
+            needs_runner = true;
+        }
+    }
+    if (needs_runner) {
+        pool_.Submit([this] { Run(); });
+    }
+    return future;
+}
+
+std::future<QueryResponse> AsyncSearchServer::SubmitQuery(std::string raw_query, Clock::duration budget,
+    DocumentStatus status, size_t max_result_count) {
+    return SubmitQuery(std::move(raw_query), Clock::now() + budget, status, max_result_count);
+}
+
+size_t AsyncSearchServer::GetQueueSize() const {
+    std::lock_guard guard(mutex_);
+    return queue_.size();
+}
+
+size_t AsyncSearchServer::GetQueueCapacity() const {
+    return queue_capacity_;
+}
+
+AsyncSearchServer::Stats AsyncSearchServer::GetStats() const {
+    std::lock_guard guard(mutex_);
+    return stats_;
+}
+
+// Запрос учитывается в статистике до того, как готов его future: кто дождался ответа, видит его в GetStats
+void AsyncSearchServer::Run() {
+    std::unique_lock lock(mutex_);
+    while (!queue_.empty()) {
+        Request request = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        std::optional<QueryResponse> response;
+        std::exception_ptr error;
+        try {
+            response = Execute(request);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        if (response) {
+            Count(response->status);
+            request.promise.set_value(std::move(*response));
+        }
+        else {
+            Count(std::nullopt);
+            request.promise.set_exception(error);
+        }
+    }
+    --runner_count_;
+    runner_done_.notify_all();
+}
+
+QueryResponse AsyncSearchServer::Execute(const Request& request) const {
+    //Запрос мог простоять в очереди до срока - тогда не ищем совсем
+    if (Clock::now() >= request.deadline) {
+        return { QueryStatus::EXPIRED, {} };
+    }
+    SearchDeadline deadline(request.deadline);
+    std::vector<Document> documents = get_version_()->FindTopDocuments(
+        request.raw_query, request.status, request.max_result_count, deadline);
+    return { deadline.WasReached() ? QueryStatus::PARTIAL : QueryStatus::COMPLETE, std::move(documents) };
+}
+
+void AsyncSearchServer::DropExpired(Clock::time_point now) {
+    const auto expired = std::stable_partition(queue_.begin(), queue_.end(),
+        [now](const Request& request) { return request.deadline > now; });
+    for (auto it = expired; it != queue_.end(); ++it) {
+        it->promise.set_value({ QueryStatus::EXPIRED, {} });
+        Count(QueryStatus::EXPIRED);
+    }
+    queue_.erase(expired, queue_.end());
+}
+
+void AsyncSearchServer::Count(std::optional<QueryStatus> status) {
+    if (!status) {
+        ++stats_.failed;
+        return;
+    }
+    switch (*status) {
+    case QueryStatus::COMPLETE:
+        ++stats_.complete;
+        break;
+    case QueryStatus::PARTIAL:
+        ++stats_.partial;
+        break;
+    case QueryStatus::EXPIRED:
+        ++stats_.expired;
+        break;
+    case QueryStatus::REJECTED:
+        ++stats_.rejected;
+        break;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "concurrent_search_server.h"
+#include "search_deadline.h"
+#include "thread_pool.h"
+
+
+//Сколько запросов по умолчанию может ждать выполнения
+const size_t ASYNC_QUEUE_CAPACITY = 1024;
+
+//Чем закончился асинхронный запрос
+enum class QueryStatus {
+    COMPLETE,   //результат полный
+    PARTIAL,    //срок наступил во время поиска: лучшие из уже просмотренных документов
+    EXPIRED,    //срок наступил до начала поиска: запрос не выполнялся
+    REJECTED,   //очередь была заполнена: запрос не принят
+};
+
+struct QueryResponse {
+    QueryStatus status;
+    std::vector<Document> documents;
+};
+
+//Асинхронные запросы к серверу. SubmitQuery сразу возвращает future, а запрос ждёт в ограниченной очереди,
+//пока его не возьмёт обработчик на пуле потоков (обработчиков не больше, чем потоков пула).
+//У каждого запроса свой срок: запрос, срок которого наступил в очереди, выбрасывается без поиска,
+//а поиск, не успевший к сроку, возвращает неполный результат.
+//При перегрузке лишние запросы сбрасываются, а не копятся: когда очередь заполнена, из неё сначала
+//выбрасываются просроченные запросы, а если места всё равно нет, новый запрос сразу отклоняется.
+//Поэтому принятый запрос ждёт не дольше, чем выполняется очередь ограниченной длины.
+//Ошибки запроса (недопустимые слова) передаются через future. Ждать future в потоке того же пула нельзя:
+//если так заблокируются все его потоки, запросы выполнять будет некому
+class AsyncSearchServer {
+public:
+    using Clock = SearchDeadline::Clock;
+
+    //Сколько запросов чем закончилось (ошибочные - в failed). Запрос учтён, как только готов его future
+    struct Stats {
+        size_t complete = 0;
+        size_t partial = 0;
+        size_t expired = 0;
+        size_t rejected = 0;
+        size_t failed = 0;
+    };
+
+    //Запросы к серверу search_server; он не должен меняться и должен жить дольше AsyncSearchServer
+    explicit AsyncSearchServer(const SearchServer& search_server, size_t queue_capacity = ASYNC_QUEUE_CAPACITY,
+        ThreadPool& pool = ThreadPool::GetDefault());
+    //Каждый запрос выполняется по версии ConcurrentSearchServer, текущей на момент начала поиска
+    explicit AsyncSearchServer(const ConcurrentSearchServer& search_server, size_t queue_capacity = ASYNC_QUEUE_CAPACITY,
+        ThreadPool& pool = ThreadPool::GetDefault());
+    //Дожидаемся всех принятых запросов
+    ~AsyncSearchServer();
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    //Ставим запрос в очередь: ТОП-документы по статусу не позже срока deadline
+    std::future<QueryResponse> SubmitQuery(std::string raw_query, Clock::time_point deadline,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT);
+    //То же со сроком через budget после постановки
+    std::future<QueryResponse> SubmitQuery(std::string raw_query, Clock::duration budget,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT);
+
+    //Сколько запросов ждёт в очереди
+    size_t GetQueueSize() const;
+    size_t GetQueueCapacity() const;
+    Stats GetStats() const;
+
+private:
+    struct Request {
+        std::string raw_query;
+        Clock::time_point deadline;
+        DocumentStatus status;
+        size_t max_result_count;
+        std::promise<QueryResponse> promise;
+    };
+
+    AsyncSearchServer(std::function<std::shared_ptr<const SearchServer>()> get_version, size_t queue_capacity,
+        ThreadPool& pool);
+
+    //Тело обработчика: выполняет запросы из очереди, пока она не опустеет
+    void Run();
+    //Выполняем запрос; ошибки запроса выбрасываются
+    QueryResponse Execute(const Request& request) const;
+    //Выбрасываем из очереди запросы, срок которых уже наступил (под mutex_)
+    void DropExpired(Clock::time_point now);
+    //Учитываем, чем закончился запрос (под mutex_)
+    void Count(std::optional<QueryStatus> status);
+
+    //Текущая версия сервера для очередного запроса
+    std::function<std::shared_ptr<const SearchServer>()> get_version_;
+    ThreadPool& pool_;
+    size_t queue_capacity_;
+
+    mutable std::mutex mutex_;
+    //Будит деструктор, когда завершается обработчик
+    std::condition_variable runner_done_;
+    std::deque<Request> queue_;
+    size_t runner_count_ = 0;
+    Stats stats_;
+};
@@ -0,0 +1,344 @@
+//Бенчмарк SearchServer на синтетическом корпусе.
+//Сборка из каталога search-server (main.cpp не нужен):
+//  g++ -std=c++17 -O2 -I. benchmark/*.cpp $(ls *.cpp | grep -v main.cpp) -lpthread -o search_server_benchmark
+//Запуск: search_server_benchmark [--имя=значение ...] - параметры см. PrintUsage.
+//Результаты печатаются таблицей, а с --json=файл ещё и пишутся в JSON для отслеживания регрессий
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../search_server.h"
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../thread_pool.h"
+#include "../trace.h"
+#include "corpus_generator.h"
+
+
+using namespace std::string_literals;
+using Clock = std::chrono::steady_clock;
+
+
+namespace {
+
+struct BenchmarkOptions {
+    CorpusOptions corpus;
+    //Сколько документов удаляет замер RemoveDocument
+    size_t remove_count = 1000;
+    //Сколько раз повторяются замеры целых пакетов (ProcessQueries, RemoveDuplicates)
+    size_t repeat_count = 3;
+    size_t thread_count = 0;
+    std::string json_path;
+    //Трасса Chrome trace events (см. trace.h); в буферах потоков остаются только последние события
+    std::string trace_path;
+};
+
+//Замер одной точки входа: длительности отдельных операций (или повторов пакета) и сколько элементов
+//(документов, запросов) обработано за всё время
+struct BenchmarkResult {
+    std::string name;
+    std::vector<double> latencies_us;
+    size_t item_count = 0;
+};
+
+double Percentile(const std::vector<double>& sorted, double share) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(share * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size(), std::max<size_t>(1, rank)) - 1];
+}
+
+//Вызываем operation(i) для i из [0, count) и запоминаем длительность каждого вызова
+BenchmarkResult MeasureEach(const std::string& name, size_t count, const std::function<void(size_t)>& operation) {
+    BenchmarkResult result{ name, {}, count };
+    result.latencies_us.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Clock::time_point start = Clock::now();
+        operation(i);
+        result.latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    return result;
+}
+
+//Повторяем пакетную операцию repeat_count раз; за повтор обрабатывается item_count элементов
+BenchmarkResult MeasureBatch(const std::string& name, size_t repeat_count, size_t item_count,
+    const std::function<void()>& operation) {
+    BenchmarkResult result = MeasureEach(name, repeat_count, [&operation](size_t) { operation(); });
+    result.item_count = repeat_count * item_count;
+    return result;
+}
+
+struct Summary {
+    double total_s;
+    double throughput;
+    double mean_us;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double max_us;
+};
+
+Summary Summarize(const BenchmarkResult& result) {
+    std::vector<double> sorted = result.latencies_us;
+    std::sort(sorted.begin(), sorted.end());
+    const double total_us = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+    return {
+        total_us / 1e6,
+        total_us > 0.0 ? static_cast<double>(result.item_count) / (total_us / 1e6) : 0.0,
+        sorted.empty() ? 0.0 : total_us / static_cast<double>(sorted.size()),
+        Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.99),
+        sorted.empty() ? 0.0 : sorted.back()
+    };
+}
+
+void PrintTable(const std::vector<BenchmarkResult>& results, std::ostream& out) {
+    out << std::left << std::setw(32) << "benchmark"s << std::right
+        << std::setw(10) << "ops"s << std::setw(14) << "items/s"s
+        << std::setw(12) << "p50 us"s << std::setw(12) << "p90 us"s << std::setw(12) << "p99 us"s
+        << std::setw(12) << "max us"s << '\n';
+    out << std::fixed << std::setprecision(1);
+    for (const BenchmarkResult& result : results) {
+        const Summary summary = Summarize(result);
+        out << std::left << std::setw(32) << result.name << std::right
+            << std::setw(10) << result.latencies_us.size() << std::setw(14) << summary.throughput
+            << std::setw(12) << summary.p50_us << std::setw(12) << summary.p90_us << std::setw(12) << summary.p99_us
+            << std::setw(12) << summary.max_us << '\n';
+    }
+}
+
+void WriteJson(const BenchmarkOptions& options, size_t thread_count, const std::vector<BenchmarkResult>& results,
+    std::ostream& out) {
+    const CorpusOptions& corpus = options.corpus;
+    out << std::setprecision(6) << std::fixed;
+    out << "{\n  \"config\": {"
+        << "\"seed\": " << corpus.seed
+        << ", \"documents\": " << corpus.document_count
+        << ", \"vocabulary\": " << corpus.vocabulary_size
+        << ", \"zipf_exponent\": " << corpus.zipf_exponent
+        << ", \"min_document_words\": " << corpus.min_document_words
+        << ", \"max_document_words\": " << corpus.max_document_words
+        << ", \"stop_word_share\": " << corpus.stop_word_share
+        << ", \"duplicate_share\": " << corpus.duplicate_share
+        << ", \"queries\": " << corpus.query_count
+        << ", \"min_query_words\": " << corpus.min_query_words
+        << ", \"max_query_words\": " << corpus.max_query_words
+        << ", \"minus_word_rate\": " << corpus.minus_word_rate
+        << ", \"threads\": " << thread_count
+        << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Summary summary = Summarize(results[i]);
+        out << "    {\"name\": \"" << results[i].name << "\""
+            << ", \"operations\": " << results[i].latencies_us.size()
+            << ", \"items\": " << results[i].item_count
+            << ", \"total_s\": " << summary.total_s
+            << ", \"items_per_s\": " << summary.throughput
+            << ", \"latency_us\": {\"mean\": " << summary.mean_us
+            << ", \"p50\": " << summary.p50_us << ", \"p90\": " << summary.p90_us
+            << ", \"p99\": " << summary.p99_us << ", \"max\": " << summary.max_us << "}}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+void PrintUsage(std::ostream& out) {
+    const CorpusOptions defaults;
+    out << "Usage: search_server_benchmark [--option=value ...]\n"
+        << "  --seed=" << defaults.seed << "  --docs=" << defaults.document_count
+        << "  --vocabulary=" << defaults.vocabulary_size << "  --zipf=" << defaults.zipf_exponent << '\n'
+        << "  --min-doc-words=" << defaults.min_document_words << "  --max-doc-words=" << defaults.max_document_words
+        << "  --stop-word-share=" << defaults.stop_word_share << "  --duplicate-share=" << defaults.duplicate_share << '\n'
+        << "  --queries=" << defaults.query_count << "  --min-query-words=" << defaults.min_query_words
+        << "  --max-query-words=" << defaults.max_query_words << "  --minus-word-rate=" << defaults.minus_word_rate << '\n'
+        << "  --remove=1000  --repeat=3  --threads=0 (0 - by core count)  --json=<file>  --trace=<file>\n";
+}
+
+//Разбираем --имя=значение; неизвестный параметр - std::invalid_argument
+BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    CorpusOptions& corpus = options.corpus;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (argument.rfind("--"s, 0) != 0 || equals == std::string::npos) {
+            throw std::invalid_argument("Invalid argument "s + argument);
+        }
+        const std::string name = argument.substr(2, equals - 2);
+        const std::string value = argument.substr(equals + 1);
+        const auto as_size = [&value]() { return static_cast<size_t>(std::stoull(value)); };
+        if (name == "seed"s) {
+            corpus.seed = std::stoull(value);
+        } else if (name == "docs"s) {
+            corpus.document_count = as_size();
+        } else if (name == "vocabulary"s) {
+            corpus.vocabulary_size = as_size();
+        } else if (name == "zipf"s) {
+            corpus.zipf_exponent = std::stod(value);
+        } else if (name == "min-doc-words"s) {
+            corpus.min_document_words = as_size();
+        } else if (name == "max-doc-words"s) {
+            corpus.max_document_words = as_size();
+        } else if (name == "stop-word-share"s) {
+            corpus.stop_word_share = std::stod(value);
+        } else if (name == "duplicate-share"s) {
+            corpus.duplicate_share = std::stod(value);
+        } else if (name == "queries"s) {
+            corpus.query_count = as_size();
+        } else if (name == "min-query-words"s) {
+            corpus.min_query_words = as_size();
+        } else if (name == "max-query-words"s) {
+            corpus.max_query_words = as_size();
+        } else if (name == "minus-word-rate"s) {
+            corpus.minus_word_rate = std::stod(value);
+        } else if (name == "remove"s) {
+            options.remove_count = as_size();
+        } else if (name == "repeat"s) {
+            options.repeat_count = std::max<size_t>(1, as_size());
+        } else if (name == "threads"s) {
+            options.thread_count = as_size();
+        } else if (name == "json"s) {
+            options.json_path = value;
+        } else if (name == "trace"s) {
+            options.trace_path = value;
+        } else {
+            throw std::invalid_argument("Unknown option "s + name);
+        }
+    }
+    return options;
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options, ThreadPool& pool) {
+    const CorpusGenerator generator(options.corpus);
+    const std::vector<GeneratedDocument> documents = generator.GenerateDocuments();
+    const std::vector<std::string> queries = generator.GenerateQueries();
+    const PoolPolicy par = pool.GetPolicy();
+    std::vector<BenchmarkResult> results;
+
+    SearchServer search_server(generator.GetStopWordsText());
+    results.push_back(MeasureEach("AddDocument"s, documents.size(), [&](size_t i) {
+        const GeneratedDocument& document = documents[i];
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }));
+    {
+        std::vector<std::tuple<int, std::string_view, DocumentStatus, std::vector<int>>> batch;
+        batch.reserve(documents.size());
+        for (const GeneratedDocument& document : documents) {
+            batch.emplace_back(document.id, document.text, document.status, document.ratings);
+        }
+        results.push_back(MeasureBatch("AddDocuments/par"s, 1, batch.size(), [&]() {
+            SearchServer batch_server(generator.GetStopWordsText());
+            batch_server.AddDocuments(par, batch);
+        }));
+    }
+
+    results.push_back(MeasureEach("FindTopDocuments/seq"s, queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::seq, queries[i]);
+    }));
+    results.push_back(MeasureEach("FindTopDocuments/par"s, queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(par, queries[i]);
+    }));
+
+    //Матчим запросы с документами по кругу
+    std::vector<int> document_ids(search_server.begin(), search_server.end());
+    results.push_back(MeasureEach("MatchDocument/seq"s, queries.size(), [&](size_t i) {
+        search_server.MatchDocument(std::execution::seq, queries[i], document_ids[i % document_ids.size()]);
+    }));
+    results.push_back(MeasureEach("MatchDocument/par"s, queries.size(), [&](size_t i) {
+        search_server.MatchDocument(par, queries[i], document_ids[i % document_ids.size()]);
+    }));
+
+    results.push_back(MeasureBatch("ProcessQueries"s, options.repeat_count, queries.size(), [&]() {
+        ProcessQueries(search_server, queries, pool);
+    }));
+    results.push_back(MeasureBatch("ProcessQueriesBatched"s, options.repeat_count, queries.size(), [&]() {
+        ProcessQueriesBatched(search_server, queries, pool);
+    }));
+
+    //Удаляем из копий: копия делит сегменты с исходным сервером, и первое удаление в сегменте копирует его,
+    //как при работе с версиями ConcurrentSearchServer
+    const size_t remove_count = std::min(options.remove_count, document_ids.size());
+    const size_t remove_step = std::max<size_t>(1, document_ids.size() / std::max<size_t>(1, remove_count));
+    {
+        SearchServer copy = search_server;
+        results.push_back(MeasureEach("RemoveDocument/seq"s, remove_count, [&](size_t i) {
+            copy.RemoveDocument(std::execution::seq, document_ids[i * remove_step]);
+        }));
+    }
+    {
+        SearchServer copy = search_server;
+        results.push_back(MeasureEach("RemoveDocument/par"s, remove_count, [&](size_t i) {
+            copy.RemoveDocument(std::execution::par, document_ids[i * remove_step]);
+        }));
+    }
+
+    //RemoveDuplicates печатает каждый удалённый id - вывод отбрасываем
+    std::ostringstream discarded;
+    std::streambuf* const cout_buffer = std::cout.rdbuf(discarded.rdbuf());
+    results.push_back(MeasureBatch("RemoveDuplicates/seq"s, options.repeat_count, document_ids.size(), [&]() {
+        SearchServer copy = search_server;
+        RemoveDuplicates(std::execution::seq, copy);
+        discarded.str({});
+    }));
+    results.push_back(MeasureBatch("RemoveDuplicates/par"s, options.repeat_count, document_ids.size(), [&]() {
+        SearchServer copy = search_server;
+        RemoveDuplicates(par, copy);
+        discarded.str({});
+    }));
+    std::cout.rdbuf(cout_buffer);
+
+    return results;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        PrintUsage(std::cerr);
+        return EXIT_FAILURE;
+    }
+
+    ThreadPool pool(options.thread_count);
+    if (!options.trace_path.empty()) {
+        StartTracing();
+    }
+    const std::vector<BenchmarkResult> results = RunBenchmarks(options, pool);
+    StopTracing();
+    PrintTable(results, std::cout);
+
+    if (!options.trace_path.empty()) {
+        try {
+            SaveTrace(options.trace_path);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!options.json_path.empty()) {
+        std::ofstream out(options.json_path);
+        WriteJson(options, pool.GetWorkerCount(), results, out);
+        if (!out) {
+            std::cerr << "Cannot write "s << options.json_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
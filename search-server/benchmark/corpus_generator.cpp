@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cmath>
+
+#include "corpus_generator.h"
+
+
+namespace {
+
+const uint64_t DOCUMENT_STREAM = 0x646f63756d656e74ULL;
+const uint64_t QUERY_STREAM = 0x7175657279000000ULL;
+
+//Слово из цифр number в системе с основанием base, записанных буквами начиная с first_letter.
+//Слова словаря пишутся буквами a..p, стоп-слова - q..z, поэтому они не пересекаются
+std::string MakeWord(size_t number, size_t base, char first_letter, size_t min_length) {
+    std::string word;
+    do {
+        word.push_back(static_cast<char>(first_letter + number % base));
+        number /= base;
+    } while (number > 0 || word.size() < min_length);
+    return word;
+}
+
+}
+
+CorpusGenerator::Random::Random(uint64_t seed)
+    : state_(seed) {
+}
+
+uint64_t CorpusGenerator::Random::Next() {
+    uint64_t value = (state_ += 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+double CorpusGenerator::Random::NextUniform() {
+    return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+}
+
+size_t CorpusGenerator::Random::NextInRange(size_t first, size_t last) {
+    return first + static_cast<size_t>(Next() % (last - first + 1));
+}
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options)
+    : options_(options) {
+    options_.vocabulary_size = std::max<size_t>(1, options_.vocabulary_size);
+    options_.max_document_words = std::max(options_.min_document_words, options_.max_document_words);
+    options_.max_query_words = std::max(std::max<size_t>(1, options_.min_query_words), options_.max_query_words);
+
+    vocabulary_.reserve(options_.vocabulary_size);
+    cumulative_weights_.reserve(options_.vocabulary_size);
+    double weight_sum = 0.0;
+    for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+        vocabulary_.push_back(MakeWord(rank, 16, 'a', 3));
+        weight_sum += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_exponent);
+        cumulative_weights_.push_back(weight_sum);
+    }
+    for (double& weight : cumulative_weights_) {
+        weight /= weight_sum;
+    }
+    for (size_t i = 0; i < options_.stop_word_count; ++i) {
+        stop_words_.push_back(MakeWord(i, 10, 'q', 2));
+    }
+}
+
+const CorpusOptions& CorpusGenerator::GetOptions() const {
+    return options_;
+}
+
+std::string CorpusGenerator::GetStopWordsText() const {
+    std::string text;
+    for (const std::string& stop_word : stop_words_) {
+        text += stop_word;
+        text += ' ';
+    }
+    return text;
+}
+
+const std::string& CorpusGenerator::NextWord(Random& random) const {
+    const auto it = std::lower_bound(cumulative_weights_.begin(), cumulative_weights_.end(), random.NextUniform());
+    return vocabulary_[std::min<size_t>(it - cumulative_weights_.begin(), vocabulary_.size() - 1)];
+}
+
+std::vector<GeneratedDocument> CorpusGenerator::GenerateDocuments() const {
+    Random random(options_.seed ^ DOCUMENT_STREAM);
+    std::vector<GeneratedDocument> documents;
+    documents.reserve(options_.document_count);
+    //Слова документов для дубликатов
+    std::vector<std::vector<const std::string*>> document_words;
+    document_words.reserve(options_.document_count);
+
+    for (size_t i = 0; i < options_.document_count; ++i) {
+        std::vector<const std::string*> words;
+        if (!document_words.empty() && random.NextUniform() < options_.duplicate_share) {
+            words = document_words[random.NextInRange(0, document_words.size() - 1)];
+            for (size_t j = words.size(); j > 1; --j) {
+                std::swap(words[j - 1], words[random.NextInRange(0, j - 1)]);
+            }
+        } else {
+            const size_t word_count = random.NextInRange(options_.min_document_words, options_.max_document_words);
+            for (size_t j = 0; j < word_count; ++j) {
+                if (!stop_words_.empty() && random.NextUniform() < options_.stop_word_share) {
+                    words.push_back(&stop_words_[random.NextInRange(0, stop_words_.size() - 1)]);
+                } else {
+                    words.push_back(&NextWord(random));
+                }
+            }
+        }
+
+        GeneratedDocument document;
+        document.id = static_cast<int>(i);
+        for (const std::string* word : words) {
+            document.text += *word;
+            document.text += ' ';
+        }
+        //Девять из десяти документов актуальны, остальные статусы поровну
+        const size_t status = random.NextInRange(0, 29);
+        document.status = status < 27 ? DocumentStatus::ACTUAL : static_cast<DocumentStatus>(status - 26);
+        const size_t rating_count = random.NextInRange(1, 5);
+        for (size_t j = 0; j < rating_count; ++j) {
+            document.ratings.push_back(static_cast<int>(random.NextInRange(0, 20)) - 10);
+        }
+        documents.push_back(std::move(document));
+        document_words.push_back(std::move(words));
+    }
+
+    //Документы добавляются не по порядку id
+    for (size_t j = documents.size(); j > 1; --j) {
+        std::swap(documents[j - 1], documents[random.NextInRange(0, j - 1)]);
+    }
+    return documents;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateQueries() const {
+    Random random(options_.seed ^ QUERY_STREAM);
+    std::vector<std::string> queries;
+    queries.reserve(options_.query_count);
+    for (size_t i = 0; i < options_.query_count; ++i) {
+        const size_t word_count = random.NextInRange(options_.min_query_words, options_.max_query_words);
+        std::string query;
+        for (size_t j = 0; j < word_count; ++j) {
+            if (random.NextUniform() < options_.minus_word_rate) {
+                query += '-';
+            }
+            query += NextWord(random);
+            query += ' ';
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../document.h"
+
+
+//Параметры синтетического корпуса. Одни и те же параметры дают одни и те же документы и запросы
+//на любой платформе: случайные числа и распределения реализованы здесь, а не взяты из <random>
+struct CorpusOptions {
+    uint64_t seed = 42;
+
+    size_t document_count = 100000;
+    //Размер словаря; вероятность слова ранга r пропорциональна 1 / r^zipf_exponent
+    size_t vocabulary_size = 50000;
+    double zipf_exponent = 1.0;
+    size_t min_document_words = 10;
+    size_t max_document_words = 100;
+    //Доля стоп-слов среди слов документа
+    double stop_word_share = 0.2;
+    size_t stop_word_count = 30;
+    //Доля документов с тем же набором слов, что у одного из предыдущих (слова перемешаны)
+    double duplicate_share = 0.05;
+
+    size_t query_count = 10000;
+    size_t min_query_words = 1;
+    size_t max_query_words = 5;
+    //Вероятность, что слово запроса - минус-слово
+    double minus_word_rate = 0.1;
+};
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+//Генератор корпуса с ципфовским словарём. Документы и запросы берут случайные числа из разных
+//потоков, поэтому запросы не меняются при изменении параметров документов
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusOptions& options);
+
+    const CorpusOptions& GetOptions() const;
+
+    //Стоп-слова через пробел - для конструктора SearchServer
+    std::string GetStopWordsText() const;
+
+    //Документы с id 0..document_count-1 в случайном порядке
+    std::vector<GeneratedDocument> GenerateDocuments() const;
+    std::vector<std::string> GenerateQueries() const;
+
+private:
+    //Поток случайных чисел (splitmix64)
+    class Random {
+    public:
+        explicit Random(uint64_t seed);
+
+        uint64_t Next();
+        //Равномерно из [0, 1)
+        double NextUniform();
+        //Равномерно из [first, last]
+        size_t NextInRange(size_t first, size_t last);
+
+    private:
+        uint64_t state_;
+    };
+
+    //Слово словаря по ципфовскому распределению
+    const std::string& NextWord(Random& random) const;
+
+    CorpusOptions options_;
+    //Слова словаря по возрастанию ранга
+    std::vector<std::string> vocabulary_;
+    std::vector<std::string> stop_words_;
+    //Накопленные вероятности слов по рангу
+    std::vector<double> cumulative_weights_;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+//Массив, разбитый на части по CHUNK_SIZE элементов. Копии массива делят части, а часть копируется
+//при первой записи в неё (копирование при записи), поэтому копия массива стоит O(GetSize() / CHUNK_SIZE),
+//а запись в копию - не больше одной части. Часть, в которую ещё не писали, не выделяется:
+//её элементы равны T{}
+template <typename T, size_t CHUNK_SIZE>
+class ChunkedArray {
+public:
+    size_t GetSize() const {
+        return size_;
+    }
+
+    //Новые элементы равны T{}; массив только растёт
+    void Grow(size_t size) {
+        if (size > size_) {
+            size_ = size;
+            chunks_.resize((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        }
+    }
+
+    //Элемент за концом массива равен T{}
+    T Get(size_t index) const {
+        if (index >= size_) {
+            return T{};
+        }
+        const std::shared_ptr<Chunk>& chunk = chunks_[index / CHUNK_SIZE];
+        return chunk == nullptr ? T{} : (*chunk)[index % CHUNK_SIZE];
+    }
+
+    //Элемент для записи; index < GetSize(). Часть, которую делят копии, сначала копируется.
+    //Последняя чужая ссылка могла быть отпущена в другом потоке - барьер гарантирует, что все её
+    //чтения части закончились до наших записей
+    T& GetMutable(size_t index) {
+        std::shared_ptr<Chunk>& chunk = chunks_[index / CHUNK_SIZE];
+        if (chunk == nullptr) {
+            chunk = std::make_shared<Chunk>();
+        }
+        else if (chunk.use_count() > 1) {
+            chunk = std::make_shared<Chunk>(*chunk);
+        }
+        else {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return (*chunk)[index % CHUNK_SIZE];
+    }
+
+    //Сколько байт кучи занимает массив (оценка). Части, общие с копиями, считаются целиком
+    size_t GetMemoryUsage() const {
+        size_t memory_usage = chunks_.capacity() * sizeof(std::shared_ptr<Chunk>);
+        for (const auto& chunk : chunks_) {
+            if (chunk != nullptr) {
+                memory_usage += sizeof(Chunk);
+            }
+        }
+        return memory_usage;
+    }
+
+private:
+    //make_shared<Chunk>() заполняет новую часть значениями T{}
+    using Chunk = std::array<T, CHUNK_SIZE>;
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,122 @@
+#include <algorithm>
+
+#include "concurrent_request_queue.h"
+
+
+namespace {
+
+const size_t LATENCY_BITS = 36;
+const size_t RESULT_COUNT_BITS = 12;
+const size_t LAP_TAG_SHIFT = LATENCY_BITS + RESULT_COUNT_BITS;
+static_assert(ConcurrentRequestQueue::LAP_TAG_COUNT == (uint64_t(1) << (64 - LAP_TAG_SHIFT)) - 1);
+
+}
+
+double RequestStats::GetNoResultRate() const {
+    return request_count == 0 ? 0.0 : static_cast<double>(no_result_count) / static_cast<double>(request_count);
+}
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const SearchServer& search_server, size_t window_size)
+    : ConcurrentRequestQueue(
+        //Сервером не владеем - указатель без счётчика ссылок
+        [&search_server] { return std::shared_ptr<const SearchServer>(std::shared_ptr<const SearchServer>(), &search_server); },
+        window_size) {
+}
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const ConcurrentSearchServer& search_server, size_t window_size)
+    : ConcurrentRequestQueue([&search_server] { return search_server.GetVersion(); }, window_size) {
+}
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(std::function<std::shared_ptr<const SearchServer>()> get_version,
+    size_t window_size)
+    : get_version_(std::move(get_version))
+    , window_size_(std::max<size_t>(1, window_size))
+    , slots_(new std::atomic<uint64_t>[window_size_]) {
+    for (size_t i = 0; i < window_size_; ++i) {
+        slots_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    return AddFindRequest(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status; });
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+// В один слот пишут запросы разных кругов: поток, застрявший между получением номера и записью,
+// может писать в слот уже после запроса следующего круга. Поэтому запись - обмен, который проходит,
+// только пока в слоте более ранний круг: застрявший запрос теряется, а не затирает более новый.
+// Читатель отличает слот своего окна по метке круга
+void ConcurrentRequestQueue::RecordRequest(Clock::duration latency, size_t result_count) {
+    const uint64_t latency_ns = static_cast<uint64_t>(std::max<int64_t>(0,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+    const uint64_t ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t lap_tag = GetLapTag(ticket);
+    const uint64_t value = (lap_tag << LAP_TAG_SHIFT)
+        | (std::min<uint64_t>(result_count, MAX_RESULT_COUNT) << LATENCY_BITS)
+        | std::min(latency_ns, MAX_LATENCY_NS);
+    std::atomic<uint64_t>& slot = slots_[ticket % window_size_];
+    uint64_t current = slot.load(std::memory_order_relaxed);
+    while (IsLaterLap(lap_tag, current >> LAP_TAG_SHIFT)
+        && !slot.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+bool ConcurrentRequestQueue::IsLaterLap(uint64_t lap_tag, uint64_t current_lap_tag) {
+    if (current_lap_tag == 0) {
+        return true;
+    }
+    const uint64_t distance = (lap_tag + LAP_TAG_COUNT - current_lap_tag) % LAP_TAG_COUNT;
+    return distance != 0 && distance < LAP_TAG_COUNT / 2;
+}
+
+int ConcurrentRequestQueue::GetNoResultRequests() const {
+    int no_result_count = 0;
+    ForEachInWindow([&no_result_count](uint64_t, uint64_t result_count) {
+        if (result_count == 0) {
+            ++no_result_count;
+        }
+    });
+    return no_result_count;
+}
+
+RequestStats ConcurrentRequestQueue::GetStats() const {
+    RequestStats stats;
+    ForEachInWindow([&stats](uint64_t latency_ns, uint64_t result_count) {
+        ++stats.request_count;
+        if (result_count == 0) {
+            ++stats.no_result_count;
+        }
+        stats.latencies_ns.Record(latency_ns);
+        stats.result_counts.Record(result_count);
+    });
+    return stats;
+}
+
+uint64_t ConcurrentRequestQueue::GetTotalRequests() const {
+    return next_ticket_.load(std::memory_order_relaxed);
+}
+
+size_t ConcurrentRequestQueue::GetWindowSize() const {
+    return window_size_;
+}
+
+uint64_t ConcurrentRequestQueue::GetLapTag(uint64_t ticket) const {
+    return ticket / window_size_ % LAP_TAG_COUNT + 1;
+}
+
+template <typename Function>
+void ConcurrentRequestQueue::ForEachInWindow(Function function) const {
+    const uint64_t end = next_ticket_.load(std::memory_order_relaxed);
+    const uint64_t first = end - std::min<uint64_t>(end, window_size_);
+    for (uint64_t ticket = first; ticket < end; ++ticket) {
+        const uint64_t value = slots_[ticket % window_size_].load(std::memory_order_relaxed);
+        if (value >> LAP_TAG_SHIFT != GetLapTag(ticket)) {
+            continue;
+        }
+        function(value & MAX_LATENCY_NS, (value >> LATENCY_BITS) & MAX_RESULT_COUNT);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+#include "concurrent_search_server.h"
+#include "metrics.h"
+
+
+//Сколько последних запросов учитывается по умолчанию (как в RequestQueue - минут в сутках)
+const size_t REQUEST_WINDOW_SIZE = 1440;
+
+//Запросы окна: задержки и число найденных документов
+struct RequestStats {
+    size_t request_count = 0;
+    size_t no_result_count = 0;
+    Histogram latencies_ns;
+    Histogram result_counts;
+
+    //Доля запросов без результатов (0 у пустого окна)
+    double GetNoResultRate() const;
+};
+
+//Очередь запросов, общая для многих потоков. Запрос записывается в кольцевой буфер последних запросов
+//одним атомарным обменом: номер запроса берётся атомарным счётчиком, а слот хранит задержку, число
+//документов и метку круга буфера в одном 64-битном слове. Поэтому вызывающие потоки друг друга не ждут,
+//а статистика окна собирается без остановки записи: слот, который ещё пишется или уже занят запросом
+//следующего круга, просто не попадает в выборку
+class ConcurrentRequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    //Задержка не больше 2^36 нс (~68 с), число документов - не больше 4095: большие значения сохраняются как предельные
+    static constexpr uint64_t MAX_LATENCY_NS = (uint64_t(1) << 36) - 1;
+    static constexpr uint64_t MAX_RESULT_COUNT = (uint64_t(1) << 12) - 1;
+    //Метки круга идут по кругу от 1 до LAP_TAG_COUNT; 0 - слот ещё не записан
+    static constexpr uint64_t LAP_TAG_COUNT = (uint64_t(1) << 16) - 1;
+
+    //Записан ли круг с меткой lap_tag позже круга с меткой current_lap_tag. Метки сравниваются по модулю
+    //LAP_TAG_COUNT: более поздней считается метка, отстоящая вперёд меньше чем на половину круга меток
+    static bool IsLaterLap(uint64_t lap_tag, uint64_t current_lap_tag);
+
+    //Запросы к серверу search_server; он должен жить дольше очереди
+    explicit ConcurrentRequestQueue(const SearchServer& search_server, size_t window_size = REQUEST_WINDOW_SIZE);
+    //Каждый запрос выполняется по текущей версии ConcurrentSearchServer
+    explicit ConcurrentRequestQueue(const ConcurrentSearchServer& search_server, size_t window_size = REQUEST_WINDOW_SIZE);
+
+    ConcurrentRequestQueue(const ConcurrentRequestQueue&) = delete;
+    ConcurrentRequestQueue& operator=(const ConcurrentRequestQueue&) = delete;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
+    std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    //Учитываем запрос, выполненный мимо очереди
+    void RecordRequest(Clock::duration latency, size_t result_count);
+
+    //Запросы без результатов среди последних window_size
+    int GetNoResultRequests() const;
+    RequestStats GetStats() const;
+    //Сколько запросов записано за всё время
+    uint64_t GetTotalRequests() const;
+    size_t GetWindowSize() const;
+
+private:
+    ConcurrentRequestQueue(std::function<std::shared_ptr<const SearchServer>()> get_version, size_t window_size);
+
+    //Метка круга буфера, на котором записан запрос ticket; 0 - слот ещё не записан
+    uint64_t GetLapTag(uint64_t ticket) const;
+    //Вызываем function(задержка в нс, число документов) для каждого записанного запроса окна
+    template <typename Function>
+    void ForEachInWindow(Function function) const;
+
+    //Текущая версия сервера для очередного запроса
+    std::function<std::shared_ptr<const SearchServer>()> get_version_;
+    const size_t window_size_;
+    //Слот: метка круга (16 бит), число документов (12 бит), задержка в нс (36 бит)
+    std::unique_ptr<std::atomic<uint64_t>[]> slots_;
+    //Номер следующего записанного запроса
+    std::atomic<uint64_t> next_ticket_{ 0 };
+};
+
+
+template <typename DocumentPredicate>
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start_time = Clock::now();
+    std::vector<Document> documents = get_version_()->FindTopDocuments(raw_query, document_predicate);
+    RecordRequest(Clock::now() - start_time, documents.size());
+    return documents;
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <atomic>
+
+#include "concurrent_search_server.h"
+
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server)
+    : working_(std::move(search_server))
+    , version_(std::make_shared<const SearchServer>(working_)) {
+    //Писатели только запечатывают сегменты, сливает их фоновый поток
+    working_.SetMergeOnSeal(false);
+    merge_thread_ = std::thread([this] { MergeSegments(); });
+}
+
+ConcurrentSearchServer::~ConcurrentSearchServer() {
+    {
+        std::lock_guard guard(write_mutex_);
+        is_stopping_ = true;
+    }
+    merge_signal_.notify_one();
+    merge_thread_.join();
+}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::GetVersion() const {
+    return std::atomic_load(&version_);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return GetVersion()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int id_document, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+    UpdateDeferred([&](SearchServer& search_server) {
+        search_server.AddDocument(id_document, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    UpdateDeferred([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::Flush() {
+    std::lock_guard guard(write_mutex_);
+    if (has_unpublished_changes_) {
+        Publish();
+    }
+}
+
+size_t ConcurrentSearchServer::Compact() {
+    std::vector<SearchServer::SegmentMerge> compactions;
+    {
+        std::lock_guard guard(write_mutex_);
+        compactions = working_.FindCompactions();
+    }
+    size_t reclaimed_memory = 0;
+    for (const SearchServer::SegmentMerge& compaction : compactions) {
+        const size_t memory_usage = compaction.segments.front()->GetMemoryUsage();
+        std::shared_ptr<IndexSegment> compacted = SearchServer::BuildMerge(compaction);
+        const size_t compacted_memory_usage = compacted->GetMemoryUsage();
+        std::lock_guard guard(write_mutex_);
+        if (working_.ApplyMerge(compaction, std::move(compacted))) {
+            reclaimed_memory += memory_usage - std::min(memory_usage, compacted_memory_usage);
+            Publish();
+        }
+    }
+    return reclaimed_memory;
+}
+
+void ConcurrentSearchServer::Publish() {
+    const Clock::time_point start = Clock::now();
+    auto version = std::make_shared<const SearchServer>(working_);
+    last_publish_duration_ = Clock::now() - start;
+    std::atomic_store(&version_, std::shared_ptr<const SearchServer>(std::move(version)));
+    has_unpublished_changes_ = false;
+    merge_signal_.notify_one();
+}
+
+void ConcurrentSearchServer::MarkUnpublished(Clock::time_point update_start) {
+    if (!has_unpublished_changes_) {
+        has_unpublished_changes_ = true;
+        const Clock::time_point now = Clock::now();
+        publish_deadline_ = now + std::max<Clock::duration>(PUBLISH_INTERVAL, last_publish_duration_ + (now - update_start));
+        merge_signal_.notify_one();
+    }
+}
+
+// Если за время слияния писатель изменил один из сливаемых сегментов, результат выбрасывается,
+// а план строится заново по новой рабочей копии
+void ConcurrentSearchServer::MergeSegments() {
+    std::unique_lock lock(write_mutex_);
+    while (!is_stopping_) {
+        if (has_unpublished_changes_ && Clock::now() >= publish_deadline_) {
+            Publish();
+        }
+        const std::optional<SearchServer::SegmentMerge> merge = working_.FindMerge();
+        if (!merge) {
+            if (has_unpublished_changes_) {
+                merge_signal_.wait_until(lock, publish_deadline_);
+            }
+            else {
+                merge_signal_.wait(lock);
+            }
+            continue;
+        }
+        lock.unlock();
+        std::shared_ptr<IndexSegment> merged = SearchServer::BuildMerge(*merge);
+        lock.lock();
+        if (working_.ApplyMerge(*merge, std::move(merged))) {
+            Publish();
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+
+
+//Сервер, который отвечает на запросы во время изменения индекса (RCU).
+//Читатели берут текущую опубликованную версию - неизменяемый SearchServer - и работают с ней,
+//сколько нужно; писатели по очереди меняют свою рабочую копию и публикуют её копию как новую
+//версию. Старая версия освобождается, когда её отпускает последний читатель (счётчик ссылок).
+//Поиск не ждёт добавления и удаления, а они не ждут поиска.
+//Версии делят сегменты индекса и листы таблицы id, поэтому публикация копирует лишь указатели на них;
+//открытый сегмент копируется при первом добавлении в него после публикации. Одиночные изменения
+//публикуются пачками не чаще раза в PUBLISH_INTERVAL (и не чаще, чем длится само копирование):
+//иначе каждый документ копировал бы весь открытый сегмент. Сегменты сливает фоновый поток: слитый
+//сегмент строится без блокировки и публикуется отдельной версией, так что ни писатели,
+//ни читатели слияния не ждут
+class ConcurrentSearchServer {
+public:
+    //Наибольшая задержка публикации одиночных изменений
+    static constexpr std::chrono::milliseconds PUBLISH_INTERVAL{ 10 };
+
+    explicit ConcurrentSearchServer(SearchServer search_server);
+    //Останавливаем фоновое слияние (начатое слияние достраивается)
+    ~ConcurrentSearchServer();
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    //Текущая версия индекса; она не меняется и живёт, пока на неё есть ссылка
+    std::shared_ptr<const SearchServer> GetVersion() const;
+
+    //Поиск и матчинг по текущей версии
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const {
+        return GetVersion()->FindTopDocuments(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args&&... args) const {
+        return GetVersion()->MatchDocument(std::forward<Args>(args)...);
+    }
+    int GetDocumentCount() const;
+
+    //Меняем индекс и публикуем одну новую версию на все изменения update(SearchServer&).
+    //Если update выбросит исключение, уже сделанные изменения всё равно публикуются
+    template <typename Function>
+    void Update(Function update);
+
+    //Пакет документов публикуется сразу одной версией
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents);
+
+    //Одиночные изменения попадают в версию, опубликованную примерно через PUBLISH_INTERVAL
+    //(или раньше - вместе с Update, слиянием или Flush)
+    void AddDocument(int id_document, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    //Сразу публикуем неопубликованные одиночные изменения: после возврата их видят все читатели
+    void Flush();
+
+    //Сжимаем сегменты с удалёнными документами (см. SearchServer::Compact). Сегменты строятся без
+    //блокировки; сегмент, который за это время изменили или слили, остаётся до следующего раза.
+    //Возвращаем, сколько байт освободится, когда старые версии отпустят читатели
+    size_t Compact();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    //Копируем рабочий индекс в новую версию, подменяем текущую и будим фоновый поток
+    void Publish();
+
+    //Отмечаем неопубликованное изменение, начатое в update_start. Срок публикации первого такого
+    //изменения отсчитывается от его конца и не короче цены публикации: копирования версии и самого
+    //этого изменения (оно копирует открытый сегмент, который делит с версией). Так писатели тратят
+    //на публикации не больше половины времени, даже если копия дольше PUBLISH_INTERVAL
+    void MarkUnpublished(Clock::time_point update_start);
+
+    //Меняем индекс одиночным изменением; публикуем, только если срок публикации вышел,
+    //иначе публикацию откладываем до фонового потока
+    template <typename Function>
+    void UpdateDeferred(Function update);
+
+    //Тело фонового потока: публикует отложенные изменения и сливает сегменты, пока есть что сливать
+    void MergeSegments();
+
+    //Писатели (и фоновое слияние) меняют рабочую копию по одному
+    std::mutex write_mutex_;
+    SearchServer working_;
+    //Есть изменения рабочей копии, которых нет в опубликованной версии, и когда их пора опубликовать
+    bool has_unpublished_changes_ = false;
+    Clock::time_point publish_deadline_;
+    //Сколько длилось последнее копирование рабочего индекса
+    Clock::duration last_publish_duration_{};
+
+    //Опубликованная версия; читается и подменяется атомарно
+    std::shared_ptr<const SearchServer> version_;
+
+    std::condition_variable merge_signal_;
+    bool is_stopping_ = false;
+    //Объявлен последним: запускается, когда всё остальное уже создано
+    std::thread merge_thread_;
+};
+
+
+template <typename Function>
+void ConcurrentSearchServer::Update(Function update) {
+    std::lock_guard guard(write_mutex_);
+    try {
+        update(working_);
+    }
+    catch (...) {
+        Publish();
+        throw;
+    }
+    Publish();
+}
+
+template <typename Function>
+void ConcurrentSearchServer::UpdateDeferred(Function update) {
+    std::lock_guard guard(write_mutex_);
+    const Clock::time_point update_start = Clock::now();
+    try {
+        update(working_);
+    }
+    catch (...) {
+        //Сделанная часть изменения всё равно будет опубликована
+        MarkUnpublished(update_start);
+        throw;
+    }
+    MarkUnpublished(update_start);
+    if (Clock::now() >= publish_deadline_) {
+        //Срок вышел, а фоновый поток ещё не опубликовал (например, занят слиянием) - публикуем сами
+        Publish();
+    }
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+void ConcurrentSearchServer::AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents) {
+    Update([&policy, &documents](SearchServer& search_server) {
+        search_server.AddDocuments(policy, documents);
+    });
+}
@@ -6,7 +6,7 @@
 using namespace std::string_literals;
 
 
-// 
+//Храним документ
 Document::Document() = default;
 
 Document::Document(int id, double relevance, int rating)
@@ -5,7 +5,7 @@
 
 using namespace std::string_literals;
 
-// 
+//Храним документ
 struct Document {
     Document();
 
@@ -16,7 +16,7 @@ struct Document {
     int rating = 0;
 };
 
-// 
+//Статусы документа
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
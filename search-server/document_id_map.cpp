@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <atomic>
+
+#include "document_id_map.h"
+
+
+namespace {
+
+template <typename Leaf>
+auto FindEntry(Leaf& leaf, int id) {
+    return std::lower_bound(leaf.begin(), leaf.end(), id,
+        [](const auto& entry, int value) { return entry.id < value; });
+}
+
+}
+
+size_t DocumentIdMap::FindLeaf(int id) const {
+    const auto it = std::lower_bound(leaves_.begin(), leaves_.end(), id,
+        [](const std::shared_ptr<Leaf>& leaf, int value) { return leaf->back().id < value; });
+    return std::min<size_t>(it - leaves_.begin(), leaves_.size() - 1);
+}
+
+DocumentIdMap::Leaf& DocumentIdMap::GetMutableLeaf(size_t leaf) {
+    std::shared_ptr<Leaf>& entries = leaves_[leaf];
+    //Последняя чужая ссылка могла быть отпущена в другом потоке - барьер гарантирует, что все её
+    //чтения листа закончились до наших записей
+    if (entries.use_count() > 1) {
+        entries = std::make_shared<Leaf>(*entries);
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *entries;
+}
+
+uint32_t DocumentIdMap::Find(int id) const {
+    if (leaves_.empty()) {
+        return NO_INDEX;
+    }
+    const Leaf& leaf = *leaves_[FindLeaf(id)];
+    const auto it = FindEntry(leaf, id);
+    return it == leaf.end() || it->id != id ? NO_INDEX : it->document_index;
+}
+
+void DocumentIdMap::Insert(int id, uint32_t document_index) {
+    ++size_;
+    if (leaves_.empty() || (leaves_.back()->size() == LEAF_SIZE && leaves_.back()->back().id < id)) {
+        auto leaf = std::make_shared<Leaf>();
+        leaf->reserve(LEAF_SIZE);
+        leaf->push_back({ id, document_index });
+        leaves_.push_back(std::move(leaf));
+        return;
+    }
+    const size_t leaf_number = FindLeaf(id);
+    Leaf& leaf = GetMutableLeaf(leaf_number);
+    leaf.insert(FindEntry(leaf, id), { id, document_index });
+    if (leaf.size() > LEAF_SIZE) {
+        auto upper_half = std::make_shared<Leaf>(leaf.begin() + leaf.size() / 2, leaf.end());
+        leaf.resize(leaf.size() / 2);
+        leaves_.insert(leaves_.begin() + leaf_number + 1, std::move(upper_half));
+    }
+}
+
+void DocumentIdMap::SetIndex(int id, uint32_t document_index) {
+    Leaf& leaf = GetMutableLeaf(FindLeaf(id));
+    FindEntry(leaf, id)->document_index = document_index;
+}
+
+// Почти пустой лист сливается со следующим, если они помещаются в один: после массовых удалений
+// листов не остаётся больше, чем нужно
+void DocumentIdMap::Erase(int id) {
+    if (leaves_.empty()) {
+        return;
+    }
+    const size_t leaf_number = FindLeaf(id);
+    {
+        const Leaf& leaf = *leaves_[leaf_number];
+        const auto it = FindEntry(leaf, id);
+        if (it == leaf.end() || it->id != id) {
+            return;
+        }
+    }
+    --size_;
+    Leaf& leaf = GetMutableLeaf(leaf_number);
+    leaf.erase(FindEntry(leaf, id));
+    if (leaf.empty()) {
+        leaves_.erase(leaves_.begin() + leaf_number);
+    }
+    else if (leaf.size() < LEAF_SIZE / 4 && leaf_number + 1 < leaves_.size()
+        && leaf.size() + leaves_[leaf_number + 1]->size() <= LEAF_SIZE / 2) {
+        const Leaf& next = *leaves_[leaf_number + 1];
+        leaf.insert(leaf.end(), next.begin(), next.end());
+        leaves_.erase(leaves_.begin() + leaf_number + 1);
+    }
+}
+
+size_t DocumentIdMap::GetMemoryUsage() const {
+    size_t memory_usage = leaves_.capacity() * sizeof(std::shared_ptr<Leaf>);
+    for (const auto& leaf : leaves_) {
+        memory_usage += sizeof(Leaf) + leaf->capacity() * sizeof(Entry);
+    }
+    return memory_usage;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+
+//Таблица <id документа, внутренний индекс документа>, упорядоченная по id.
+//Пары лежат отсортированными листами до LEAF_SIZE пар. Копии таблицы делят листы, а лист копируется
+//при первом изменении (копирование при записи), поэтому копия таблицы стоит O(GetSize() / LEAF_SIZE),
+//а добавление, удаление или смена индекса в копии - один лист
+class DocumentIdMap {
+public:
+    //Индекс, который возвращается для отсутствующего id
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+private:
+    struct Entry {
+        int id;
+        uint32_t document_index;
+    };
+    using Leaf = std::vector<Entry>;
+
+public:
+    //Обход id по возрастанию
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            return (*(*leaves_)[leaf_])[position_].id;
+        }
+
+        //Внутренний индекс документа с текущим id
+        uint32_t GetDocumentIndex() const {
+            return (*(*leaves_)[leaf_])[position_].document_index;
+        }
+
+        const_iterator& operator++() {
+            if (++position_ == (*leaves_)[leaf_]->size()) {
+                ++leaf_;
+                position_ = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return leaf_ == other.leaf_ && position_ == other.position_;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class DocumentIdMap;
+
+        const_iterator(const std::vector<std::shared_ptr<Leaf>>* leaves, size_t leaf)
+            : leaves_(leaves)
+            , leaf_(leaf) {
+        }
+
+        const std::vector<std::shared_ptr<Leaf>>* leaves_ = nullptr;
+        size_t leaf_ = 0;
+        size_t position_ = 0;
+    };
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+    //Индекс документа или NO_INDEX, если id нет
+    uint32_t Find(int id) const;
+
+    //Добавляем id, которого ещё нет
+    void Insert(int id, uint32_t document_index);
+
+    //Меняем индекс документа с id, который уже есть
+    void SetIndex(int id, uint32_t document_index);
+
+    //Удаляем id (если он есть)
+    void Erase(int id);
+
+    const_iterator begin() const {
+        return const_iterator(&leaves_, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(&leaves_, leaves_.size());
+    }
+
+    //Сколько байт кучи занимает таблица (оценка). Листы, общие с копиями, считаются целиком
+    size_t GetMemoryUsage() const;
+
+private:
+    //Полный лист при вставке в середину делится пополам, а при вставке за последний id начинается
+    //новый лист - так id, которые добавляются по возрастанию, заполняют листы целиком
+    static constexpr size_t LEAF_SIZE = 512;
+
+    //Номер листа, в котором лежит (или должен лежать) id: первый лист с последним id не меньше id.
+    //Если id больше всех, это последний лист
+    size_t FindLeaf(int id) const;
+
+    //Лист для изменения: если его делят с другой копией таблицы, сначала копируем
+    Leaf& GetMutableLeaf(size_t leaf);
+
+    std::vector<std::shared_ptr<Leaf>> leaves_;
+    size_t size_ = 0;
+};
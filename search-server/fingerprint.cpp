@@ -0,0 +1,51 @@
+#include <functional>
+
+#include "fingerprint.h"
+
+
+namespace {
+
+//Перемешивание битов (финализатор splitmix64): без него сумма хешей похожих слов
+//складывалась бы из похожих слагаемых
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+//FNV-1a: независима от std::hash
+uint64_t Fnv1a(std::string_view word) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+}
+
+Fingerprint& Fingerprint::operator+=(const Fingerprint& other) {
+    low += other.low;
+    high += other.high;
+    return *this;
+}
+
+bool operator==(const Fingerprint& lhs, const Fingerprint& rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+bool operator!=(const Fingerprint& lhs, const Fingerprint& rhs) {
+    return !(lhs == rhs);
+}
+
+Fingerprint FingerprintWord(std::string_view word) {
+    return { Mix(std::hash<std::string_view>{}(word)), Mix(Fnv1a(word)) };
+}
+
+size_t FingerprintHasher::operator()(const Fingerprint& fingerprint) const {
+    return static_cast<size_t>(fingerprint.low ^ (fingerprint.high * 0x9e3779b97f4a7c15ULL));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+//128-битный отпечаток набора слов - сумма отпечатков его слов. Сумма не зависит от порядка слов,
+//поэтому отпечаток документа собирается из отпечатков слов любого сегмента, а не из идентификаторов
+//(они у каждого сегмента свои). Одинаковые наборы дают одинаковые отпечатки, разные совпадают
+//с ничтожной вероятностью
+struct Fingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    Fingerprint& operator+=(const Fingerprint& other);
+};
+
+bool operator==(const Fingerprint& lhs, const Fingerprint& rhs);
+bool operator!=(const Fingerprint& lhs, const Fingerprint& rhs);
+
+//Отпечаток слова: две независимые 64-битные хеш-функции
+Fingerprint FingerprintWord(std::string_view word);
+
+//Хеш отпечатка для unordered_map
+struct FingerprintHasher {
+    size_t operator()(const Fingerprint& fingerprint) const;
+};
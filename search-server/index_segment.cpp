@@ -0,0 +1,506 @@
+#include <limits>
+#include <numeric>
+#include <type_traits>
+
+#include "index_segment.h"
+
+
+IndexSegment::IndexSegment(uint32_t first_index)
+    : first_index_(first_index)
+    , content_(std::make_shared<Content>()) {
+}
+
+IndexSegment::Content& IndexSegment::GetMutableContent() {
+    //Последняя чужая ссылка могла быть отпущена в другом потоке - барьер гарантирует, что все её
+    //чтения содержимого закончились до наших записей
+    if (content_.use_count() > 1) {
+        content_ = std::make_shared<Content>(*content_);
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *content_;
+}
+
+const PostingList* IndexSegment::FindPostings(std::string_view word) const {
+    const TermId term_id = content_->dictionary.Find(word);
+    return term_id == TermDictionary::NO_TERM ? nullptr : &content_->word_to_document_freqs[term_id];
+}
+
+size_t IndexSegment::GetDocumentFrequency(std::string_view word) const {
+    const TermId term_id = content_->dictionary.Find(word);
+    if (term_id == TermDictionary::NO_TERM) {
+        return 0;
+    }
+    return content_->word_to_document_freqs[term_id].GetDocumentCount() - deleted_counts_.Get(term_id);
+}
+
+// Есть ли слово в документе - проверяем по списку вхождений слова
+bool IndexSegment::ContainsWord(std::string_view word, uint32_t document_index) const {
+    const PostingList* postings = FindPostings(word);
+    return postings != nullptr && postings->Contains(document_index);
+}
+
+std::map<std::string_view, double> IndexSegment::GetWordFrequencies(uint32_t document_index) const {
+    std::map<std::string_view, double> word_freqs;
+    const size_t document_offset = document_index - first_index_;
+    for (size_t i = GetWordBegin(document_offset); i < content_->document_word_ends[document_offset]; ++i) {
+        word_freqs.emplace(content_->dictionary.GetTerm(content_->document_word_freqs[i].term_id), content_->document_word_freqs[i].tf);
+    }
+    return word_freqs;
+}
+
+std::vector<Fingerprint> IndexSegment::GetTermFingerprints() const {
+    std::vector<Fingerprint> term_fingerprints(content_->dictionary.GetTermCount());
+    for (size_t term_id = 0; term_id < term_fingerprints.size(); ++term_id) {
+        term_fingerprints[term_id] = FingerprintWord(content_->dictionary.GetTerm(static_cast<TermId>(term_id)));
+    }
+    return term_fingerprints;
+}
+
+Fingerprint IndexSegment::GetDocumentFingerprint(uint32_t document_index, const std::vector<Fingerprint>& term_fingerprints) const {
+    Fingerprint fingerprint;
+    const size_t document_offset = document_index - first_index_;
+    for (size_t i = GetWordBegin(document_offset); i < content_->document_word_ends[document_offset]; ++i) {
+        fingerprint += term_fingerprints[content_->document_word_freqs[i].term_id];
+    }
+    return fingerprint;
+}
+
+void IndexSegment::AddDocument(int id_document, const std::vector<std::string_view>& words, DocumentStatus status, int rating) {
+    //Вычисляем TF конкретного слова в документе
+    const double tf = 1.0 / static_cast<double>(words.size());
+    const uint32_t document_index = GetEndIndex();
+    Content& content = GetMutableContent();
+
+    std::vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (std::string_view word : words) {
+        term_ids.push_back(content.dictionary.Insert(word));
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    if (content.word_to_document_freqs.size() < content.dictionary.GetTermCount()) {
+        content.word_to_document_freqs.resize(content.dictionary.GetTermCount());
+    }
+
+    //Повторы слова стоят рядом - копим TF на последнем элементе
+    const size_t word_begin = content.document_word_freqs.size();
+    for (TermId term_id : term_ids) {
+        if (content.document_word_freqs.size() == word_begin || content.document_word_freqs.back().term_id != term_id) {
+            content.document_word_freqs.push_back({ term_id, 0.0 });
+        }
+        content.document_word_freqs.back().tf += tf;
+    }
+    //Индекс нового документа больше всех предыдущих - списки остаются отсортированными
+    for (size_t i = word_begin; i < content.document_word_freqs.size(); ++i) {
+        content.word_to_document_freqs[content.document_word_freqs[i].term_id].PushBack(document_index, content.document_word_freqs[i].tf,
+            content.term_frequencies);
+    }
+    content.document_word_ends.push_back(content.document_word_freqs.size());
+    content.documents.push_back({ id_document, rating, status });
+    ++document_count_;
+}
+
+// Списки вхождений пакета строятся сортировкой подсчётом: каждая часть пакета раскладывает свои вхождения
+// по словам, после чего списки разных слов дописываются параллельно. Последовательно (и только для новых
+// слов и значений TF) меняются лишь словарь и таблица TF
+template <typename ExecutionPolicy>
+void IndexSegment::AddDocuments(const ExecutionPolicy& policy, std::vector<PendingDocument>& batch) {
+    LOG_TRACE("IndexDocuments");
+    Content& content = GetMutableContent();
+    //Уже известные идентификаторы слов и номера TF ищем параллельно - словарь и таблица пока не меняются
+    {
+        LOG_TRACE("LookupTerms");
+        ForEach(
+            policy,
+            batch.begin(), batch.end(),
+            [&content](PendingDocument& pending) {
+                //Различных значений TF в документе всего несколько - ищем каждое в таблице один раз
+                std::vector<std::pair<double, uint32_t>> tf_codes;
+                for (PendingWord& word : pending.words) {
+                    word.term_id = content.dictionary.Find(word.word);
+                    auto it = std::find_if(tf_codes.begin(), tf_codes.end(),
+                        [&word](const auto& tf_code) { return tf_code.first == word.tf; });
+                    if (it == tf_codes.end()) {
+                        it = tf_codes.insert(tf_codes.end(), { word.tf, content.term_frequencies.Find(word.tf) });
+                    }
+                    word.tf_code = it->second;
+                    pending.has_new_words = pending.has_new_words || word.term_id == TermDictionary::NO_TERM
+                        || word.tf_code == TermFrequencyTable::NO_CODE;
+                }
+            }
+        );
+    }
+
+    for (PendingDocument& pending : batch) {
+        if (!pending.has_new_words) {
+            continue;
+        }
+        for (PendingWord& word : pending.words) {
+            if (word.term_id == TermDictionary::NO_TERM) {
+                word.term_id = content.dictionary.Insert(word.word);
+            }
+            if (word.tf_code == TermFrequencyTable::NO_CODE) {
+                word.tf_code = content.term_frequencies.Encode(word.tf);
+            }
+        }
+    }
+    if (content.word_to_document_freqs.size() < content.dictionary.GetTermCount()) {
+        content.word_to_document_freqs.resize(content.dictionary.GetTermCount());
+    }
+
+    //Прямой индекс: место под слова пакета выделяется сразу, документы заполняют свои диапазоны параллельно,
+    //слова документа - по возрастанию идентификатора
+    const size_t first_document_offset = content.documents.size();
+    size_t word_count = content.document_word_freqs.size();
+    for (const PendingDocument& pending : batch) {
+        word_count += pending.words.size();
+        content.document_word_ends.push_back(word_count);
+    }
+    content.document_word_freqs.resize(word_count);
+    {
+        LOG_TRACE("BuildForwardIndex");
+        ForEach(
+            policy,
+            batch.begin(), batch.end(),
+            [&](PendingDocument& pending) {
+                std::sort(pending.words.begin(), pending.words.end(),
+                    [](const PendingWord& lhs, const PendingWord& rhs) { return lhs.term_id < rhs.term_id; });
+                size_t i = GetWordBegin(first_document_offset + (&pending - batch.data()));
+                for (const PendingWord& word : pending.words) {
+                    content.document_word_freqs[i++] = { word.term_id, word.tf };
+                }
+            }
+        );
+    }
+
+    //Части пакета - непрерывные диапазоны документов, поэтому вхождения части k идут в списках раньше части k + 1
+    const uint32_t first_index = GetEndIndex();
+    const size_t term_count = content.word_to_document_freqs.size();
+    size_t thread_count = 1;
+    if constexpr (IS_PARALLEL_POLICY<ExecutionPolicy>) {
+        thread_count = GetThreadPool(policy).GetWorkerCount();
+    }
+    const size_t part_count = std::max<size_t>(1, std::min(thread_count, batch.size() / MIN_BATCH_PART_SIZE));
+    //Вхождения части, разложенные по словам; вхождения слова term начинаются с term_begins[term]
+    std::vector<std::vector<PendingPosting>> part_postings(part_count);
+    std::vector<std::vector<uint32_t>> part_term_begins(part_count);
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+
+    ForEach(
+        policy,
+        parts.begin(), parts.end(),
+        [&](size_t part) {
+            LOG_TRACE("SplitPostings");
+            const size_t first = part * batch.size() / part_count;
+            const size_t last = (part + 1) * batch.size() / part_count;
+            std::vector<uint32_t>& term_begins = part_term_begins[part];
+            term_begins.assign(term_count, 0);
+            for (size_t i = first; i < last; ++i) {
+                for (const PendingWord& word : batch[i].words) {
+                    ++term_begins[word.term_id];
+                }
+            }
+            std::partial_sum(term_begins.begin(), term_begins.end(), term_begins.begin());
+            //Раскладываем с конца: внутри слова вхождения остаются по возрастанию индекса документа,
+            //а счётчик слова в итоге указывает на начало его вхождений
+            std::vector<PendingPosting>& postings = part_postings[part];
+            postings.resize(term_count > 0 ? term_begins.back() : 0);
+            for (size_t i = last; i-- > first;) {
+                const uint32_t document_index = first_index + static_cast<uint32_t>(i);
+                for (const PendingWord& word : batch[i].words) {
+                    postings[--term_begins[word.term_id]] = { word.term_id, document_index, word.tf_code };
+                }
+            }
+        }
+    );
+
+    //Слияние: каждый поток дописывает списки своего диапазона слов, обходя части по порядку
+    const size_t range_count = std::min(term_count, thread_count * TERM_RANGES_PER_THREAD);
+    std::vector<size_t> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+
+    ForEach(
+        policy,
+        ranges.begin(), ranges.end(),
+        [&](size_t range) {
+            LOG_TRACE("MergePostings");
+            const size_t first_term = range * term_count / range_count;
+            const size_t last_term = (range + 1) * term_count / range_count;
+            for (size_t part = 0; part < part_count; ++part) {
+                const std::vector<PendingPosting>& postings = part_postings[part];
+                const std::vector<uint32_t>& term_begins = part_term_begins[part];
+                const size_t end = last_term < term_count ? term_begins[last_term] : postings.size();
+                for (size_t i = term_begins[first_term]; i < end; ++i) {
+                    content.word_to_document_freqs[postings[i].term_id].PushBackCode(postings[i].document_index, postings[i].tf_code,
+                        content.term_frequencies);
+                }
+            }
+        }
+    );
+
+    content.documents.reserve(content.documents.size() + batch.size());
+    for (const PendingDocument& pending : batch) {
+        content.documents.push_back({ pending.id, pending.rating, pending.status });
+    }
+    document_count_ += batch.size();
+}
+
+template void IndexSegment::AddDocuments(const std::execution::sequenced_policy&, std::vector<PendingDocument>&);
+template void IndexSegment::AddDocuments(const std::execution::parallel_policy&, std::vector<PendingDocument>&);
+template void IndexSegment::AddDocuments(const PoolPolicy&, std::vector<PendingDocument>&);
+
+void IndexSegment::RemoveDocument(uint32_t document_index) {
+    const size_t document_offset = document_index - first_index_;
+    //Содержимое не меняется: копируются только части пометок, в которые пишем
+    deleted_bits_.Grow((content_->documents.size() + DELETED_WORD_BITS - 1) / DELETED_WORD_BITS);
+    deleted_bits_.GetMutable(document_offset / DELETED_WORD_BITS) |= uint64_t(1) << (document_offset % DELETED_WORD_BITS);
+    deleted_counts_.Grow(content_->dictionary.GetTermCount());
+    //Число документов со словом нужно для IDF: вычитаем удалённый документ из каждого своего слова
+    for (size_t i = GetWordBegin(document_offset); i < content_->document_word_ends[document_offset]; ++i) {
+        ++deleted_counts_.GetMutable(content_->document_word_freqs[i].term_id);
+    }
+    ++tombstone_count_;
+    --document_count_;
+}
+
+void IndexSegment::Seal() {
+    Content& content = GetMutableContent();
+    for (PostingList& postings : content.word_to_document_freqs) {
+        postings.Seal();
+    }
+    content.packed_postings = PostingList::PackBlocks(content.word_to_document_freqs);
+    content.word_to_document_freqs.shrink_to_fit();
+    content.document_word_freqs.shrink_to_fit();
+    content.document_word_ends.shrink_to_fit();
+    content.documents.shrink_to_fit();
+    content.is_sealed = true;
+}
+
+// Удалённых документов в новом сегменте нет совсем, поэтому и пометки не переносятся. Живые документы
+// получают индексы подряд в прежнем порядке - вхождения в списках остаются по возрастанию индекса
+IndexSegment IndexSegment::Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments) {
+    IndexSegment merged(segments.front()->first_index_);
+    Content& merged_content = *merged.content_;
+    for (const auto& segment : segments) {
+        //<смещение документа в сегменте, новый индекс> (у удалённых документов не используется)
+        std::vector<uint32_t> new_indices(segment->content_->documents.size());
+        uint32_t next_index = merged.GetEndIndex();
+        for (size_t document_offset = 0; document_offset < new_indices.size(); ++document_offset) {
+            if (!segment->IsDeleted(segment->first_index_ + static_cast<uint32_t>(document_offset))) {
+                new_indices[document_offset] = next_index++;
+            }
+        }
+
+        //<идентификатор слова в сегменте, идентификатор в общем словаре>
+        std::vector<TermId> term_ids(segment->content_->word_to_document_freqs.size(), TermDictionary::NO_TERM);
+        for (TermId term_id = 0; term_id < term_ids.size(); ++term_id) {
+            const PostingList& postings = segment->content_->word_to_document_freqs[term_id];
+            if (postings.GetDocumentCount() == segment->deleted_counts_.Get(term_id)) {
+                continue;
+            }
+            term_ids[term_id] = merged_content.dictionary.Insert(segment->content_->dictionary.GetTerm(term_id));
+            if (merged_content.word_to_document_freqs.size() < merged_content.dictionary.GetTermCount()) {
+                merged_content.word_to_document_freqs.resize(merged_content.dictionary.GetTermCount());
+            }
+            //Сегменты идут по возрастанию индексов - вхождения дописываются в конец списков
+            PostingList& merged_postings = merged_content.word_to_document_freqs[term_ids[term_id]];
+            postings.ForEachInRange(segment->first_index_, segment->GetEndIndex(), segment->content_->term_frequencies,
+                [&merged_content, &merged_postings, &segment, &new_indices](uint32_t document_index, double tf) {
+                    if (!segment->IsDeleted(document_index)) {
+                        merged_postings.PushBack(new_indices[document_index - segment->first_index_], tf,
+                            merged_content.term_frequencies);
+                    }
+                }
+            );
+        }
+
+        for (size_t document_offset = 0; document_offset < segment->content_->documents.size(); ++document_offset) {
+            if (segment->IsDeleted(segment->first_index_ + static_cast<uint32_t>(document_offset))) {
+                continue;
+            }
+            const size_t word_begin = merged_content.document_word_freqs.size();
+            for (size_t i = segment->GetWordBegin(document_offset); i < segment->content_->document_word_ends[document_offset]; ++i) {
+                merged_content.document_word_freqs.push_back({ term_ids[segment->content_->document_word_freqs[i].term_id],
+                    segment->content_->document_word_freqs[i].tf });
+            }
+            std::sort(merged_content.document_word_freqs.begin() + word_begin, merged_content.document_word_freqs.end(),
+                [](const WordFrequency& lhs, const WordFrequency& rhs) { return lhs.term_id < rhs.term_id; });
+            merged_content.document_word_ends.push_back(merged_content.document_word_freqs.size());
+            merged_content.documents.push_back(segment->content_->documents[document_offset]);
+        }
+        merged.document_count_ += segment->document_count_;
+    }
+    merged.Seal();
+    return merged;
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+    size_t memory_usage = content_->dictionary.GetMemoryUsage() + content_->term_frequencies.GetMemoryUsage()
+        + content_->word_to_document_freqs.capacity() * sizeof(PostingList)
+        + content_->document_word_freqs.capacity() * sizeof(WordFrequency) + content_->document_word_ends.capacity() * sizeof(size_t)
+        + content_->documents.capacity() * sizeof(DocumentData)
+        + deleted_bits_.GetMemoryUsage() + deleted_counts_.GetMemoryUsage();
+    for (const PostingList& postings : content_->word_to_document_freqs) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+    if (content_->packed_postings != nullptr) {
+        memory_usage += content_->packed_postings->GetMemoryUsage();
+    }
+    return memory_usage;
+}
+
+// Порядок раздела сегмента: первый индекс, число живых документов и признак запечатанности, словарь, таблица TF,
+// списки вхождений по идентификаторам слов, документы, прямой индекс, удалённые документы
+void IndexSegment::Save(SnapshotWriter& writer) const {
+    writer.Write(static_cast<uint64_t>(first_index_));
+    writer.Write(static_cast<uint64_t>(document_count_));
+    writer.Write(static_cast<uint64_t>(content_->is_sealed));
+
+    std::vector<std::string_view> terms;
+    terms.reserve(content_->dictionary.GetTermCount());
+    for (TermId term_id = 0; term_id < content_->dictionary.GetTermCount(); ++term_id) {
+        terms.push_back(content_->dictionary.GetTerm(term_id));
+    }
+    writer.WriteStrings(terms);
+
+    std::vector<double> tf_values;
+    tf_values.reserve(content_->term_frequencies.GetSize());
+    for (uint32_t code = 0; code < content_->term_frequencies.GetSize(); ++code) {
+        tf_values.push_back(content_->term_frequencies.Decode(code));
+    }
+    writer.Write(static_cast<uint64_t>(tf_values.size()));
+    writer.WriteArray(tf_values.data(), tf_values.size());
+
+    //Список вхождений есть у каждого слова словаря, поэтому номер списка в файле - идентификатор слова
+    for (const PostingList& postings : content_->word_to_document_freqs) {
+        postings.Save(writer);
+    }
+
+    writer.Write(static_cast<uint64_t>(content_->documents.size()));
+    writer.WriteArray(content_->documents.data(), content_->documents.size());
+
+    //Прямой индекс удалённых документов не пишем
+    std::vector<uint64_t> word_ends;
+    std::vector<TermId> term_ids;
+    std::vector<double> tfs;
+    word_ends.reserve(content_->documents.size());
+    for (size_t document_offset = 0; document_offset < content_->documents.size(); ++document_offset) {
+        if (!IsDeleted(first_index_ + static_cast<uint32_t>(document_offset))) {
+            for (size_t i = GetWordBegin(document_offset); i < content_->document_word_ends[document_offset]; ++i) {
+                term_ids.push_back(content_->document_word_freqs[i].term_id);
+                tfs.push_back(content_->document_word_freqs[i].tf);
+            }
+        }
+        word_ends.push_back(term_ids.size());
+    }
+    writer.WriteArray(word_ends.data(), word_ends.size());
+    writer.Write(static_cast<uint64_t>(term_ids.size()));
+    writer.WriteArray(term_ids.data(), term_ids.size());
+    writer.WriteArray(tfs.data(), tfs.size());
+
+    //Удалённые документы: смещения помеченных и счётчики удалённых по словам
+    std::vector<uint32_t> deleted_offsets;
+    for (size_t document_offset = 0; document_offset < content_->documents.size(); ++document_offset) {
+        if (IsDeleted(first_index_ + static_cast<uint32_t>(document_offset))) {
+            deleted_offsets.push_back(static_cast<uint32_t>(document_offset));
+        }
+    }
+    writer.Write(static_cast<uint64_t>(deleted_offsets.size()));
+    writer.WriteArray(deleted_offsets.data(), deleted_offsets.size());
+    writer.Write(static_cast<uint64_t>(tombstone_count_));
+    std::vector<uint32_t> deleted_counts(deleted_counts_.GetSize());
+    for (TermId term_id = 0; term_id < deleted_counts.size(); ++term_id) {
+        deleted_counts[term_id] = deleted_counts_.Get(term_id);
+    }
+    writer.Write(static_cast<uint64_t>(deleted_counts.size()));
+    writer.WriteArray(deleted_counts.data(), deleted_counts.size());
+}
+
+IndexSegment IndexSegment::Open(SnapshotReader& reader, std::shared_ptr<const MappedFile> snapshot) {
+    IndexSegment segment(static_cast<uint32_t>(reader.Read<uint64_t>()));
+    Content& content = *segment.content_;
+    content.snapshot = std::move(snapshot);
+    segment.document_count_ = reader.Read<uint64_t>();
+    content.is_sealed = reader.Read<uint64_t>() != 0;
+
+    const std::vector<std::string_view> terms = reader.ReadStrings();
+    for (TermId term_id = 0; term_id < terms.size(); ++term_id) {
+        if (content.dictionary.InsertMapped(terms[term_id]) != term_id) {
+            throw std::invalid_argument("Snapshot dictionary contains a repeated word"s);
+        }
+    }
+
+    const uint64_t tf_count = reader.Read<uint64_t>();
+    const double* tf_values = reader.ReadArray<double>(tf_count);
+    for (size_t code = 0; code < tf_count; ++code) {
+        //Повторное значение сдвинуло бы номера всех следующих
+        if (content.term_frequencies.Encode(tf_values[code]) != code) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+    }
+
+    content.word_to_document_freqs.reserve(terms.size());
+    for (size_t term_id = 0; term_id < terms.size(); ++term_id) {
+        content.word_to_document_freqs.push_back(PostingList::Open(reader));
+    }
+
+    const uint64_t document_count = reader.Read<uint64_t>();
+    const DocumentData* documents = reader.ReadArray<DocumentData>(document_count);
+    content.documents.assign(documents, documents + document_count);
+    //Списки вхождений проверяем, когда известен диапазон индексов сегмента
+    const uint64_t end_index = uint64_t(segment.first_index_) + document_count;
+    if (end_index > UINT32_MAX) {
+        throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+    }
+    for (const PostingList& postings : content.word_to_document_freqs) {
+        if (!postings.IsValid(segment.first_index_, static_cast<uint32_t>(end_index), content.term_frequencies)) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+    }
+
+    const uint64_t* word_ends = reader.ReadArray<uint64_t>(document_count);
+    const uint64_t word_count = reader.Read<uint64_t>();
+    const TermId* term_ids = reader.ReadArray<TermId>(word_count);
+    const double* tfs = reader.ReadArray<double>(word_count);
+    uint64_t word_begin = 0;
+    for (size_t document_offset = 0; document_offset < document_count; ++document_offset) {
+        if (word_ends[document_offset] < word_begin || word_ends[document_offset] > word_count) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        word_begin = word_ends[document_offset];
+    }
+    content.document_word_ends.assign(word_ends, word_ends + document_count);
+    content.document_word_freqs.reserve(word_count);
+    for (size_t i = 0; i < word_count; ++i) {
+        if (term_ids[i] >= terms.size()) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        content.document_word_freqs.push_back({ term_ids[i], tfs[i] });
+    }
+
+    const uint64_t deleted_count = reader.Read<uint64_t>();
+    const uint32_t* deleted_offsets = reader.ReadArray<uint32_t>(deleted_count);
+    segment.deleted_bits_.Grow((document_count + DELETED_WORD_BITS - 1) / DELETED_WORD_BITS);
+    for (size_t i = 0; i < deleted_count; ++i) {
+        if (deleted_offsets[i] >= document_count) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        segment.deleted_bits_.GetMutable(deleted_offsets[i] / DELETED_WORD_BITS) |=
+            uint64_t(1) << (deleted_offsets[i] % DELETED_WORD_BITS);
+    }
+    segment.tombstone_count_ = reader.Read<uint64_t>();
+    const uint64_t deleted_counts_size = reader.Read<uint64_t>();
+    if (deleted_counts_size > terms.size()) {
+        throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+    }
+    const uint32_t* deleted_counts = reader.ReadArray<uint32_t>(deleted_counts_size);
+    segment.deleted_counts_.Grow(deleted_counts_size);
+    for (TermId term_id = 0; term_id < deleted_counts_size; ++term_id) {
+        if (deleted_counts[term_id] != 0) {
+            segment.deleted_counts_.GetMutable(term_id) = deleted_counts[term_id];
+        }
+    }
+    return segment;
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <execution>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "chunked_array.h"
+#include "document.h"
+#include "fingerprint.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+
+
+//Минимальное число документов в части пакета при параллельном добавлении
+const size_t MIN_BATCH_PART_SIZE = 1024;
+//Сколько диапазонов слов приходится на один поток при слиянии вхождений пакета
+const size_t TERM_RANGES_PER_THREAD = 4;
+
+//Сегмент индекса: документы с внутренними индексами [first_index, first_index + GetSlotCount()).
+//У сегмента свои словарь, списки вхождений, таблица TF, прямой индекс и данные документов.
+//Новые документы дописываются в открытый сегмент; запечатанный сегмент больше не дополняется,
+//а его списки вхождений упакованы целиком, включая хвосты.
+//Удалённый документ только помечается: его вхождения остаются в списках и пропускаются при поиске,
+//пока сегмент не перепишут слиянием (Merge) - тогда уходят и вхождения, и слова словаря, и сам документ:
+//живые документы получают индексы подряд, поэтому слитый сегмент может оказаться короче исходных.
+//После слияний между сегментами могут оставаться пропуски индексов. Новые документы получают индексы после последнего сегмента,
+//поэтому пространство индексов (uint32) расходуется каждым добавлением, а возвращается, только когда
+//слияние укорачивает последний сегмент.
+//Память сегмента - несколько больших массивов, а не выделение на каждое слово или документ:
+//прямой индекс лежит одним массивом на все документы, а при запечатывании сжатые блоки всех списков
+//вхождений переносятся в общую память (PostingList::PackBlocks).
+//Копии сегмента делят его содержимое (словарь, списки вхождений, прямой индекс, документы) и части
+//пометок удалённых (ChunkedArray): добавление копирует содержимое, только если его делят с другой копией,
+//а удаление копирует лишь части пометок, в которые пишет. Поэтому копия сегмента, которую делают версии
+//сервера (ConcurrentSearchServer) перед удалением, стоит O(число частей пометок), а не O(размер сегмента)
+class IndexSegment {
+public:
+    //Храним инфу о документах
+    struct DocumentData {
+        int id;
+        int rating;
+        DocumentStatus document_status;
+    };
+
+    //Слово документа: идентификатор слова и TF
+    struct WordFrequency {
+        TermId term_id;
+        double tf;
+    };
+
+    //Слово документа из пакета: до добавления в словарь известно только само слово
+    struct PendingWord {
+        std::string_view word;
+        TermId term_id;
+        double tf;
+        uint32_t tf_code;
+    };
+
+    //Документ пакетного добавления
+    struct PendingDocument {
+        int id;
+        std::string_view text;
+        DocumentStatus status;
+        int rating;
+        bool has_valid_words = true;
+        //Есть слова, которых ещё нет в словаре, или значения TF, которых нет в таблице
+        bool has_new_words = false;
+        //Различные слова документа с TF
+        std::vector<PendingWord> words;
+    };
+
+    explicit IndexSegment(uint32_t first_index);
+
+    uint32_t GetFirstIndex() const {
+        return first_index_;
+    }
+
+    //Индекс, который получит следующий документ сегмента
+    uint32_t GetEndIndex() const {
+        return first_index_ + static_cast<uint32_t>(content_->documents.size());
+    }
+
+    //Сколько индексов занято, включая удалённые документы
+    size_t GetSlotCount() const {
+        return content_->documents.size();
+    }
+
+    //Сколько документов не удалено
+    size_t GetDocumentCount() const {
+        return document_count_;
+    }
+
+    bool IsSealed() const {
+        return content_->is_sealed;
+    }
+
+    const DocumentData& GetDocument(uint32_t document_index) const {
+        return content_->documents[document_index - first_index_];
+    }
+
+    bool IsDeleted(uint32_t document_index) const {
+        const size_t document_offset = document_index - first_index_;
+        return (deleted_bits_.Get(document_offset / DELETED_WORD_BITS) >> (document_offset % DELETED_WORD_BITS)) & 1;
+    }
+
+    //Сколько удалённых документов ещё лежит в списках вхождений
+    size_t GetTombstoneCount() const {
+        return tombstone_count_;
+    }
+
+    //Список вхождений слова или nullptr, если слова в сегменте нет. В списке могут быть удалённые документы
+    const PostingList* FindPostings(std::string_view word) const;
+
+    //Сколько неудалённых документов сегмента содержат слово
+    size_t GetDocumentFrequency(std::string_view word) const;
+
+    const TermFrequencyTable& GetTermFrequencies() const {
+        return content_->term_frequencies;
+    }
+
+    //Есть ли слово в документе
+    bool ContainsWord(std::string_view word, uint32_t document_index) const;
+
+    //Частоты слов документа; представления слов живут столько же, сколько сегмент
+    std::map<std::string_view, double> GetWordFrequencies(uint32_t document_index) const;
+
+    //Отпечатки слов сегмента по идентификатору слова
+    std::vector<Fingerprint> GetTermFingerprints() const;
+    //Отпечаток набора слов документа по отпечаткам слов сегмента (GetTermFingerprints)
+    Fingerprint GetDocumentFingerprint(uint32_t document_index, const std::vector<Fingerprint>& term_fingerprints) const;
+
+    //Добавляем документ со словами words (уже без стоп-слов) под индексом GetEndIndex()
+    void AddDocument(int id_document, const std::vector<std::string_view>& words, DocumentStatus status, int rating);
+
+    //Добавляем проверенный пакет под индексами начиная с GetEndIndex() (определено для seq, par и PoolPolicy)
+    template <typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, std::vector<PendingDocument>& batch);
+
+    //Помечаем документ удалённым; списки вхождений и прямой индекс не меняются (их память вернёт Merge),
+    //индекс остаётся занятым
+    void RemoveDocument(uint32_t document_index);
+
+    //Запечатываем сегмент: упаковываем хвосты списков, переносим их блоки в общую память и отдаём лишнюю
+    void Seal();
+
+    //Запечатанный сегмент из соседних сегментов (по возрастанию индексов) без удалённых документов:
+    //живые документы перенумеровываются подряд с первого индекса первого сегмента.
+    //В новый словарь попадают только слова, у которых остались вхождения
+    static IndexSegment Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments);
+
+    //Сколько байт кучи занимает сегмент (оценка; отображённый снимок не считается)
+    size_t GetMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+    //Сегмент, словарь и списки вхождений которого остаются в отображённом снимке
+    static IndexSegment Open(SnapshotReader& reader, std::shared_ptr<const MappedFile> snapshot);
+
+private:
+    //Пометки удалённых лежат битами в 64-битных словах, по 64 слова (4096 документов) в части
+    static constexpr size_t DELETED_WORD_BITS = 64;
+    static constexpr size_t DELETED_CHUNK_SIZE = 64;
+    //Счётчиков удалённых по словам - по 256 в части: удаление копирует по части на каждое своё слово
+    static constexpr size_t DELETED_COUNT_CHUNK_SIZE = 256;
+
+    //Содержимое сегмента; копии сегмента делят его, пока его не дополняют
+    struct Content {
+        //Снимок, в который указывают словарь и списки вхождений (nullptr, если сегмент построен в памяти).
+        //Объявлен первым, чтобы освобождаться последним
+        std::shared_ptr<const MappedFile> snapshot;
+        //Общая память сжатых блоков списков запечатанного сегмента; делится с копиями сегмента
+        std::shared_ptr<const PostingList::PackedBlocks> packed_postings;
+
+        bool is_sealed = false;
+
+        //Все слова документов сегмента с их идентификаторами
+        TermDictionary dictionary;
+        //      < идентификатор слова(индекс)   < (индекс документа, номер TF) - сжатыми блоками >>.
+        //Индексы выдаются по возрастанию, поэтому новый документ всегда дописывается в конец списка
+        std::vector<PostingList> word_to_document_freqs;
+        //Различные значения TF, на которые ссылаются списки вхождений
+        TermFrequencyTable term_frequencies;
+        //Прямой индекс: (идентификатор слова, TF) всех документов подряд, у документа - по возрастанию идентификатора.
+        //Слова документа с индексом first_index_ + offset лежат в [GetWordBegin(offset), document_word_ends[offset])
+        std::vector<WordFrequency> document_word_freqs;
+        std::vector<size_t> document_word_ends;
+        //Инфа о документах по индексу документа - first_index_
+        std::vector<DocumentData> documents;
+    };
+
+    //Содержимое для изменения: если его делят с другой копией сегмента, сначала копируем
+    Content& GetMutableContent();
+
+    //Начало слов документа в document_word_freqs
+    size_t GetWordBegin(size_t document_offset) const {
+        return document_offset == 0 ? 0 : content_->document_word_ends[document_offset - 1];
+    }
+
+    //Вхождение слова в документ пакета, ещё не попавшее в список вхождений
+    struct PendingPosting {
+        TermId term_id;
+        uint32_t document_index;
+        uint32_t tf_code;
+    };
+
+    uint32_t first_index_;
+    size_t document_count_ = 0;
+    std::shared_ptr<Content> content_;
+
+    //Пометки удалённых документов: бит с номером (индекс документа - first_index_)
+    ChunkedArray<uint64_t, DELETED_CHUNK_SIZE> deleted_bits_;
+    //Сколько удалённых документов ещё есть в списке вхождений слова, по идентификатору слова
+    ChunkedArray<uint32_t, DELETED_COUNT_CHUNK_SIZE> deleted_counts_;
+    size_t tombstone_count_ = 0;
+};
+
@@ -2,6 +2,10 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+
+#include "metrics.h"
+#include "trace.h"
 
 using namespace std::string_literals;
 
@@ -10,21 +14,40 @@ using namespace std::string_literals;
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
 #define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
+#define LOG_STAGE(profile, stage) StageDuration UNIQUE_VAR_NAME_PROFILE(profile, stage)
+#ifdef SEARCH_SERVER_NO_TRACING
+#define LOG_TRACE(x)
+#else
+#define LOG_TRACE(x) TraceScope UNIQUE_VAR_NAME_PROFILE(x)
+#endif
 
 class LogDuration {
 public:
-    //    std::chrono::steady_clock
-    //   using  
+    // заменим имя типа std::chrono::steady_clock
+    // с помощью using для удобства
     using Clock = std::chrono::steady_clock;
 
-    LogDuration(const std::string& id, std::ostream& out) :
+    LogDuration(const std::string& id, std::ostream& out = std::cerr) :
         id_(id), out_(out) {
+#ifndef SEARCH_SERVER_NO_TRACING
+        //Область попадает и в трассировку (см. trace.h)
+        is_traced_ = IsTracingEnabled();
+        if (is_traced_) {
+            TraceBegin(id_);
+        }
+#endif
     }
 
     ~LogDuration() {
         using namespace std::chrono;
         using namespace std::literals;
 
+#ifndef SEARCH_SERVER_NO_TRACING
+        if (is_traced_) {
+            TraceEnd();
+        }
+#endif
+
         const auto end_time = Clock::now();
         const auto dur = end_time - start_time_;
         out_ << id_ << "Operation time: "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
@@ -35,4 +58,63 @@ private:
     std::ostream& out_ = std::cerr;
 
     const Clock::time_point start_time_ = Clock::now();
-};
\ No newline at end of file
+#ifndef SEARCH_SERVER_NO_TRACING
+    bool is_traced_ = false;
+#endif
+};
+
+// Время области добавляется к этапу запроса в профиле (см. metrics.h).
+// Без профиля (nullptr - метрики выключены) часы не читаются
+class StageDuration {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    StageDuration(QueryProfile* profile, QueryStage stage) :
+        profile_(profile), stage_(stage) {
+        if (profile_ != nullptr) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    ~StageDuration() {
+        if (profile_ != nullptr) {
+            profile_->AddStageTime(stage_, Clock::now() - start_time_);
+        }
+    }
+
+    StageDuration(const StageDuration&) = delete;
+    StageDuration& operator=(const StageDuration&) = delete;
+
+private:
+    QueryProfile* const profile_;
+    const QueryStage stage_;
+    Clock::time_point start_time_;
+};
+
+// Область в трассировке (см. trace.h); при выключенной записи - одна проверка флага.
+// Конец пишется, только если было записано начало, даже если запись уже остановлена
+class TraceScope {
+public:
+    explicit TraceScope(std::string_view name) :
+        is_traced_(IsTracingEnabled()) {
+        if (is_traced_) {
+            TraceBegin(name);
+        }
+    }
+
+    explicit TraceScope(const TraceName& name) :
+        TraceScope(name.GetView()) {
+    }
+
+    ~TraceScope() {
+        if (is_traced_) {
+            TraceEnd();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const bool is_traced_;
+};
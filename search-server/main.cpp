@@ -1,16 +1,27 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <future>
+#include <iterator>
 #include <map>
 #include <numeric>
 #include <random>
+#include <set>
+#include <thread>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <mutex>
 
 #include "log_duration.h"
 #include "test_framework.h"
+#include "concurrent_map.h"
 #include "search_server.h"
+#include "concurrent_request_queue.h"
+#include "async_search_server.h"
 #include "process_queries.h"
 
 using namespace std;
@@ -95,9 +106,855 @@ void TestSpeedup() {
     }
 }
 
+void TestZeroResultCount() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat and bird"s, DocumentStatus::ACTUAL, { 2 });
+
+    ASSERT(search_server.FindTopDocuments("cat dog"s, DocumentStatus::ACTUAL, 0).empty());
+    ASSERT(search_server.FindTopDocuments(execution::par, "cat dog"s, DocumentStatus::ACTUAL, 0).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat dog"s).size(), 2u);
+
+    const vector<string_view> queries = { "cat"sv, "dog -bird"sv };
+    const auto batch_results = search_server.FindTopDocumentsBatch(execution::par, queries, DocumentStatus::ACTUAL, 0);
+    ASSERT_EQUAL(batch_results.size(), queries.size());
+    ASSERT(all_of(batch_results.begin(), batch_results.end(), [](const vector<Document>& documents) { return documents.empty(); }));
+}
+
+string MakeRandomText(mt19937& generator, size_t word_count, unsigned vocabulary_size) {
+    string text;
+    for (size_t i = 0; i < word_count; ++i) {
+        //Small word numbers are much more frequent, so their posting lists span many blocks
+        text += "w"s + to_string(generator() % (1 + generator() % vocabulary_size)) + " "s;
+    }
+    return text;
+}
+
+void AssertEqualDocuments(const vector<Document>& lhs, const vector<Document>& rhs, const string& hint) {
+    AssertEqual(lhs.size(), rhs.size(), hint);
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        AssertEqual(lhs[i].id, rhs[i].id, hint);
+        Assert(abs(lhs[i].relevance - rhs[i].relevance) < 1e-9, hint);
+        AssertEqual(lhs[i].rating, rhs[i].rating, hint);
+    }
+}
+
+string ReadFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return { istreambuf_iterator<char>(in), istreambuf_iterator<char>() };
+}
+
+void WriteFile(const string& path, const string& data) {
+    ofstream out(path, ios::binary);
+    out << data;
+}
+
+//An opened snapshot stays mapped, so a file is never rewritten while a server opened from it is alive
+const string TEST_SNAPSHOT_PATH = "test_snapshot.bin"s;
+const string TEST_COMPACTED_SNAPSHOT_PATH = "test_snapshot_compacted.bin"s;
+
+void AssertSameIndex(SearchServer& expected, SearchServer& actual, const vector<string>& queries) {
+    ASSERT_EQUAL(actual.GetDocumentCount(), expected.GetDocumentCount());
+    ASSERT(vector<int>(actual.begin(), actual.end()) == vector<int>(expected.begin(), expected.end()));
+    const auto is_odd = [](int id, DocumentStatus, int) { return id % 2 == 1; };
+    for (const string& query : queries) {
+        AssertEqualDocuments(actual.FindTopDocuments(query), expected.FindTopDocuments(query), query);
+        AssertEqualDocuments(actual.FindTopDocuments(execution::par, query, DocumentStatus::BANNED, 20),
+            expected.FindTopDocuments(execution::par, query, DocumentStatus::BANNED, 20), query);
+        AssertEqualDocuments(actual.FindTopDocuments(query, is_odd), expected.FindTopDocuments(query, is_odd), query);
+    }
+    for (const int id : expected) {
+        for (const string& query : queries) {
+            ASSERT(actual.MatchDocument(query, id) == expected.MatchDocument(query, id));
+        }
+    }
+}
+
+void TestSnapshotRoundTrip() {
+    mt19937 generator(9);
+    SearchServer search_server("and w0"s);
+    for (int id = 0; id < 20000; ++id) {
+        search_server.AddDocument(id * 3, MakeRandomText(generator, 3 + generator() % 10, 2000),
+            static_cast<DocumentStatus>(generator() % 3), { static_cast<int>(generator() % 10) - 3 });
+    }
+    for (int id = 0; id < 20000; id += 7) {
+        search_server.RemoveDocument(id * 3);
+    }
+    search_server.RemoveDocuments({ 3, 6, 9, 100000 });
+    const vector<string> queries = { "w1 w2 -w3"s, "w5 w17 w400"s, "w1999 w1"s, "w4 -w4"s, "w2 w3 w5 w7 w11 w13"s };
+
+    search_server.SaveSnapshot(TEST_SNAPSHOT_PATH);
+    SearchServer opened = SearchServer::OpenSnapshot(TEST_SNAPSHOT_PATH);
+    AssertSameIndex(search_server, opened, queries);
+
+    search_server.AddDocument(100001, "w1 w2 w3"s, DocumentStatus::ACTUAL, { 5 });
+    opened.AddDocument(100001, "w1 w2 w3"s, DocumentStatus::ACTUAL, { 5 });
+    search_server.RemoveDocument(12);
+    opened.RemoveDocument(12);
+    AssertSameIndex(search_server, opened, queries);
+
+    ASSERT(search_server.Compact() > 0);
+    search_server.SaveSnapshot(TEST_COMPACTED_SNAPSHOT_PATH);
+    SearchServer compacted = SearchServer::OpenSnapshot(TEST_COMPACTED_SNAPSHOT_PATH);
+    AssertSameIndex(search_server, compacted, queries);
+    AssertSameIndex(opened, compacted, queries);
+    remove(TEST_SNAPSHOT_PATH.c_str());
+    remove(TEST_COMPACTED_SNAPSHOT_PATH.c_str());
+}
+
+bool IsSnapshotRejected(const string& data) {
+    WriteFile(TEST_SNAPSHOT_PATH, data);
+    try {
+        SearchServer::OpenSnapshot(TEST_SNAPSHOT_PATH);
+    }
+    catch (const invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+void TestSnapshotRejectsCorruptFiles() {
+    //One posting list with full blocks: "cat" is in every document, other words are unique
+    SearchServer search_server(""s);
+    for (int id = 0; id < 300; ++id) {
+        search_server.AddDocument(id, "cat w"s + to_string(id), DocumentStatus::ACTUAL, { 1 });
+    }
+    search_server.SaveSnapshot(TEST_SNAPSHOT_PATH);
+    const string data = ReadFile(TEST_SNAPSHOT_PATH);
+    ASSERT(!IsSnapshotRejected(data));
+
+    ASSERT(IsSnapshotRejected(data.substr(0, data.size() - 1)));
+    ASSERT(IsSnapshotRejected(data.substr(0, data.size() / 2)));
+    ASSERT(IsSnapshotRejected(data.substr(0, 10)));
+    ASSERT(IsSnapshotRejected(data + "x"s));
+
+    //Header: 8-byte magic, then the format version
+    string wrong_version = data;
+    const uint32_t next_version = SNAPSHOT_VERSION + 1;
+    memcpy(&wrong_version[8], &next_version, sizeof(next_version));
+    ASSERT(IsSnapshotRejected(wrong_version));
+
+    //Block header of the first "cat" block: first and last document index, data offset, size, bit widths
+    const uint32_t block_start[] = { 0, 127, 0 };
+    string block_pattern(reinterpret_cast<const char*>(block_start), sizeof(block_start));
+    block_pattern += static_cast<char>(128);
+    const size_t block = data.find(block_pattern);
+    ASSERT(block != string::npos);
+    const size_t size_offset = block + sizeof(block_start);
+    for (const auto& [field_offset, value] : vector<pair<size_t, uint8_t>>{ { 0, 0 }, { 0, 129 }, { 1, 33 }, { 2, 40 } }) {
+        string corrupted = data;
+        corrupted[size_offset + field_offset] = static_cast<char>(value);
+        AssertEqual(IsSnapshotRejected(corrupted), true, "block field "s + to_string(field_offset));
+    }
+    string bad_offset = data;
+    const uint32_t far_offset = 1u << 30;
+    memcpy(&bad_offset[block + 2 * sizeof(uint32_t)], &far_offset, sizeof(far_offset));
+    ASSERT(IsSnapshotRejected(bad_offset));
+    string bad_last_index = data;
+    const uint32_t wrong_last_index = 126;
+    memcpy(&bad_last_index[block + sizeof(uint32_t)], &wrong_last_index, sizeof(wrong_last_index));
+    ASSERT(IsSnapshotRejected(bad_last_index));
+    remove(TEST_SNAPSHOT_PATH.c_str());
+}
+
+vector<Document> SortById(vector<Document> documents) {
+    sort(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs) { return lhs.id < rhs.id; });
+    return documents;
+}
+
+void TestCompactDropsDeletedDocuments() {
+    mt19937 generator(13);
+    SearchServer search_server("and"s);
+    SearchServer live_only("and"s);
+    vector<int> removed_ids;
+    for (int id = 0; id < 20000; ++id) {
+        const string text = MakeRandomText(generator, 3 + generator() % 8, 1000);
+        const int rating = static_cast<int>(generator() % 10);
+        if (id % 5 == 0) {
+            search_server.AddDocument(id, text + " doomed"s, DocumentStatus::ACTUAL, { rating });
+            removed_ids.push_back(id);
+        }
+        else {
+            search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { rating });
+            live_only.AddDocument(id, text, DocumentStatus::ACTUAL, { rating });
+        }
+    }
+    search_server.RemoveDocuments(removed_ids);
+    const size_t memory_usage = search_server.GetMemoryUsage();
+
+    const size_t reclaimed_memory = search_server.Compact();
+    ASSERT(reclaimed_memory > 0);
+    ASSERT(search_server.GetMemoryUsage() < memory_usage);
+    ASSERT_EQUAL(search_server.Compact(), 0u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), live_only.GetDocumentCount());
+    ASSERT(vector<int>(search_server.begin(), search_server.end()) == vector<int>(live_only.begin(), live_only.end()));
+    ASSERT(search_server.FindTopDocuments("doomed"s).empty());
+
+    for (const string& query : { "w1 w2 -w3"s, "w7 w70 w700"s, "w1 doomed"s }) {
+        AssertEqualDocuments(SortById(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 100000)),
+            SortById(live_only.FindTopDocuments(query, DocumentStatus::ACTUAL, 100000)), query);
+    }
+    for (const int id : removed_ids) {
+        ASSERT(search_server.GetWordFrequencies(id).empty());
+    }
+    try {
+        search_server.MatchDocument("w1"s, removed_ids.front());
+        ASSERT(false);
+    }
+    catch (const out_of_range&) {
+    }
+}
+
+void TestMergeDropsDeadTerms() {
+    auto segment = make_shared<IndexSegment>(0);
+    segment->AddDocument(10, { "cat"sv, "doomed"sv }, DocumentStatus::ACTUAL, 1);
+    segment->AddDocument(11, { "cat"sv, "dog"sv }, DocumentStatus::ACTUAL, 2);
+    segment->RemoveDocument(0);
+    ASSERT(segment->ContainsWord("doomed"sv, 0));
+    ASSERT_EQUAL(segment->GetDocumentFrequency("doomed"sv), 0u);
+    ASSERT_EQUAL(segment->GetTombstoneCount(), 1u);
+
+    const IndexSegment merged = IndexSegment::Merge({ segment });
+    ASSERT(merged.FindPostings("doomed"sv) == nullptr);
+    ASSERT(!merged.ContainsWord("doomed"sv, 0));
+    ASSERT_EQUAL(merged.GetSlotCount(), 1u);
+    ASSERT_EQUAL(merged.GetDocumentCount(), 1u);
+    ASSERT_EQUAL(merged.GetTombstoneCount(), 0u);
+    ASSERT_EQUAL(merged.GetDocument(0).id, 11);
+    ASSERT(merged.ContainsWord("dog"sv, 0));
+    ASSERT_EQUAL(merged.GetDocumentFrequency("cat"sv), 1u);
+    ASSERT(merged.GetMemoryUsage() < segment->GetMemoryUsage());
+}
+
+struct ModelDocument {
+    map<string, double> word_tfs;
+    DocumentStatus status;
+    int rating;
+};
+
+//Reference model of the index: documents are scored one by one, without posting lists or pruning
+class BruteForceIndex {
+public:
+    explicit BruteForceIndex(set<string> stop_words)
+        : stop_words_(move(stop_words)) {
+    }
+
+    void AddDocument(int id, const string& text, DocumentStatus status, int rating) {
+        vector<string> words;
+        for (const string& word : SplitWords(text)) {
+            if (!stop_words_.count(word)) {
+                words.push_back(word);
+            }
+        }
+        ModelDocument& document = documents_[id];
+        document = { {}, status, rating };
+        for (const string& word : words) {
+            document.word_tfs[word] += 1.0 / static_cast<double>(words.size());
+        }
+        for (const auto& [word, tf] : document.word_tfs) {
+            ++document_frequencies_[word];
+        }
+    }
+
+    void RemoveDocument(int id) {
+        const auto it = documents_.find(id);
+        if (it == documents_.end()) {
+            return;
+        }
+        for (const auto& [word, tf] : it->second.word_tfs) {
+            --document_frequencies_[word];
+        }
+        documents_.erase(it);
+    }
+
+    const map<int, ModelDocument>& GetDocuments() const {
+        return documents_;
+    }
+
+    //All matching documents, best first
+    template <typename Predicate>
+    vector<Document> FindAllDocuments(const string& raw_query, Predicate predicate) const {
+        set<string> plus_words;
+        set<string> minus_words;
+        for (const string& word : SplitWords(raw_query)) {
+            if (word[0] == '-') {
+                if (!stop_words_.count(word.substr(1))) {
+                    minus_words.insert(word.substr(1));
+                }
+            }
+            else if (!stop_words_.count(word)) {
+                plus_words.insert(word);
+            }
+        }
+        map<string, double> idfs;
+        for (const string& word : plus_words) {
+            const auto it = document_frequencies_.find(word);
+            const size_t document_frequency = it == document_frequencies_.end() ? 0 : it->second;
+            idfs[word] = document_frequency == 0 ? 0.0
+                : log(static_cast<double>(documents_.size()) / static_cast<double>(document_frequency));
+        }
+
+        vector<Document> found;
+        for (const auto& [id, document] : documents_) {
+            const auto& word_tfs = document.word_tfs;
+            if (any_of(minus_words.begin(), minus_words.end(), [&word_tfs](const string& word) { return word_tfs.count(word) > 0; })
+                || !predicate(id, document.status, document.rating)) {
+                continue;
+            }
+            bool is_matched = false;
+            double relevance = 0.0;
+            for (const string& word : plus_words) {
+                const auto it = word_tfs.find(word);
+                if (it != word_tfs.end()) {
+                    is_matched = true;
+                    relevance += it->second * idfs.at(word);
+                }
+            }
+            if (is_matched) {
+                found.push_back({ id, relevance, document.rating });
+            }
+        }
+        stable_sort(found.begin(), found.end(), IsMoreRelevant);
+        return found;
+    }
+
+private:
+    static vector<string> SplitWords(const string& text) {
+        vector<string> words;
+        for (size_t begin = 0; begin < text.size();) {
+            const size_t end = min(text.find(' ', begin), text.size());
+            if (end > begin) {
+                words.push_back(text.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+        return words;
+    }
+
+    set<string> stop_words_;
+    map<int, ModelDocument> documents_;
+    map<string, size_t> document_frequencies_;
+};
+
+//Documents with equal relevance and rating may come in any order, so the top is checked by its
+//(relevance, rating) keys and by the reference relevance of every returned document
+void AssertIsTopOf(const vector<Document>& actual, const vector<Document>& all_found, size_t max_count, const string& hint) {
+    AssertEqual(actual.size(), min(max_count, all_found.size()), hint);
+    map<int, const Document*> found_by_id;
+    for (const Document& document : all_found) {
+        found_by_id[document.id] = &document;
+    }
+    set<int> ids;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        Assert(abs(actual[i].relevance - all_found[i].relevance) < 1e-9, hint + " relevance at "s + to_string(i));
+        AssertEqual(actual[i].rating, all_found[i].rating, hint + " rating at "s + to_string(i));
+        const auto it = found_by_id.find(actual[i].id);
+        Assert(it != found_by_id.end(), hint + " unexpected id "s + to_string(actual[i].id));
+        Assert(abs(it->second->relevance - actual[i].relevance) < 1e-9, hint + " id "s + to_string(actual[i].id));
+        Assert(ids.insert(actual[i].id).second, hint + " repeated id "s + to_string(actual[i].id));
+    }
+}
+
+string MakeRandomQuery(mt19937& generator) {
+    string query;
+    for (unsigned i = 1 + generator() % 4; i > 0; --i) {
+        query += "w"s + to_string(generator() % (1 + generator() % 300)) + " "s;
+    }
+    for (unsigned i = generator() % 3; i > 0; --i) {
+        query += "-w"s + to_string(generator() % 300) + " "s;
+    }
+    if (generator() % 4 == 0) {
+        query += "and"s;
+    }
+    return query;
+}
+
+void AssertMatchesBruteForce(const SearchServer& search_server, const BruteForceIndex& reference, ThreadPool& pool,
+    mt19937& generator) {
+    ASSERT_EQUAL(static_cast<size_t>(search_server.GetDocumentCount()), reference.GetDocuments().size());
+    const auto has_good_rating = [](int, DocumentStatus, int rating) { return rating > 2; };
+    const size_t max_counts[] = { 1, 5, 20, 200 };
+
+    vector<string> queries;
+    vector<vector<Document>> actual_found;
+    for (int i = 0; i < 25; ++i) {
+        queries.push_back(MakeRandomQuery(generator));
+        actual_found.push_back(reference.FindAllDocuments(queries.back(),
+            [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; }));
+    }
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const string& query = queries[i];
+        const size_t max_count = max_counts[generator() % size(max_counts)];
+        const DocumentStatus status = static_cast<DocumentStatus>(generator() % 3);
+        const auto has_status = [status](int, DocumentStatus document_status, int) { return document_status == status; };
+        const vector<Document> by_status = status == DocumentStatus::ACTUAL ? actual_found[i]
+            : reference.FindAllDocuments(query, has_status);
+        AssertIsTopOf(search_server.FindTopDocuments(query, status, max_count), by_status, max_count, "seq "s + query);
+        AssertIsTopOf(search_server.FindTopDocuments(execution::par, query, status, max_count), by_status, max_count,
+            "par "s + query);
+        AssertIsTopOf(search_server.FindTopDocuments(pool.GetPolicy(), query, status, max_count), by_status, max_count,
+            "pool "s + query);
+        const vector<Document> by_rating = reference.FindAllDocuments(query, has_good_rating);
+        AssertIsTopOf(search_server.FindTopDocuments(query, has_good_rating, max_count), by_rating, max_count,
+            "predicate "s + query);
+        AssertIsTopOf(search_server.FindTopDocuments(execution::par, query, has_good_rating, max_count), by_rating, max_count,
+            "par predicate "s + query);
+    }
+
+    const vector<string_view> batch(queries.begin(), queries.end());
+    for (const size_t max_count : max_counts) {
+        const auto seq_results = search_server.FindTopDocumentsBatch(execution::seq, batch, DocumentStatus::ACTUAL, max_count);
+        const auto par_results = search_server.FindTopDocumentsBatch(pool.GetPolicy(), batch, DocumentStatus::ACTUAL, max_count);
+        ASSERT_EQUAL(seq_results.size(), queries.size());
+        ASSERT_EQUAL(par_results.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            AssertIsTopOf(seq_results[i], actual_found[i], max_count, "batch "s + queries[i]);
+            AssertIsTopOf(par_results[i], actual_found[i], max_count, "par batch "s + queries[i]);
+        }
+    }
+}
+
+void TestSearchMatchesBruteForce() {
+    mt19937 generator(6);
+    ThreadPool pool(3);
+    SearchServer search_server("and"s);
+    BruteForceIndex reference({ "and"s });
+    vector<int> ids;
+    vector<string> texts;
+    //Four sealed segments of one level get merged; frequent words have lists much longer than a block
+    const auto add_documents = [&](int count) {
+        vector<tuple<int, string, DocumentStatus, vector<int>>> batch;
+        for (int i = 0; i < count; ++i) {
+            const int id = static_cast<int>(ids.size()) * 2 + 1;
+            //Every tenth document repeats an earlier text: equal relevance, so the rating decides
+            const string text = texts.empty() || generator() % 10 != 0 ? MakeRandomText(generator, 2 + generator() % 10, 300)
+                : texts[generator() % texts.size()];
+            const DocumentStatus status = static_cast<DocumentStatus>(generator() % 3);
+            const int rating = static_cast<int>(generator() % 12) - 3;
+            ids.push_back(id);
+            texts.push_back(text);
+            reference.AddDocument(id, text, status, rating);
+            if (i % 2 == 0) {
+                search_server.AddDocument(id, text, status, { rating });
+            }
+            else {
+                batch.push_back({ id, text, status, { rating } });
+            }
+            if (batch.size() == 1000 || (i + 1 == count && !batch.empty())) {
+                search_server.AddDocuments(execution::par, batch);
+                batch.clear();
+            }
+        }
+    };
+    const auto remove_documents = [&](size_t count) {
+        vector<int> batch;
+        for (size_t i = 0; i < count; ++i) {
+            const int id = ids[generator() % ids.size()];
+            reference.RemoveDocument(id);
+            if (i % 2 == 0) {
+                search_server.RemoveDocument(id);
+            }
+            else {
+                batch.push_back(id);
+            }
+        }
+        search_server.RemoveDocuments(batch);
+    };
+
+    add_documents(10000);
+    AssertMatchesBruteForce(search_server, reference, pool, generator);
+    remove_documents(3000);
+    AssertMatchesBruteForce(search_server, reference, pool, generator);
+    add_documents(60000);
+    ASSERT(search_server.GetSegmentCount() < 5u);
+    remove_documents(20000);
+    AssertMatchesBruteForce(search_server, reference, pool, generator);
+    ASSERT(search_server.Compact() > 0);
+    AssertMatchesBruteForce(search_server, reference, pool, generator);
+}
+
+void TestResultCacheInvalidation() {
+    SearchServer search_server("and"s);
+    const auto cache = make_shared<ResultCache>(10);
+    search_server.SetResultCache(cache);
+    search_server.AddDocument(1, "white cat and collar"s, DocumentStatus::ACTUAL, { 8 });
+    search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7 });
+    search_server.AddDocument(3, "groomed dog"s, DocumentStatus::ACTUAL, { 5 });
+    const auto find_ids = [&search_server](const string& query) {
+        vector<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        return ids;
+    };
+    //Every step must miss once and then hit with the same result
+    const auto assert_refreshed = [&cache, &find_ids](const string& query, const vector<int>& expected_ids, const string& hint) {
+        const size_t hit_count = cache->GetHitCount();
+        const size_t miss_count = cache->GetMissCount();
+        AssertEqual(find_ids(query) == expected_ids, true, hint);
+        AssertEqual(cache->GetMissCount(), miss_count + 1, hint);
+        AssertEqual(find_ids(query) == expected_ids, true, hint);
+        AssertEqual(cache->GetHitCount(), hit_count + 1, hint);
+    };
+
+    assert_refreshed("cat"s, { 1, 2 }, "first search"s);
+    search_server.AddDocument(4, "cat cat cat"s, DocumentStatus::ACTUAL, { 1 });
+    assert_refreshed("cat"s, { 4, 1, 2 }, "AddDocument"s);
+    search_server.RemoveDocument(2);
+    assert_refreshed("cat"s, { 4, 1 }, "RemoveDocument"s);
+    search_server.RemoveDocuments({ 4, 100 });
+    assert_refreshed("cat"s, { 1 }, "RemoveDocuments"s);
+
+    //Removing nothing keeps the generation and the cached result
+    const uint64_t generation = search_server.GetGeneration();
+    search_server.RemoveDocument(100);
+    search_server.RemoveDocuments({ 100, 200 });
+    ASSERT_EQUAL(search_server.GetGeneration(), generation);
+    const size_t hit_count = cache->GetHitCount();
+    ASSERT(find_ids("cat"s) == vector<int>{ 1 });
+    ASSERT_EQUAL(cache->GetHitCount(), hit_count + 1);
+}
+
+void TestResultCacheSurvivesMerges() {
+    SearchServer search_server("and"s);
+    search_server.SetMergeOnSeal(false);
+    //A batch goes into one segment, so each batch fills exactly one
+    for (size_t segment = 0; segment < MERGE_FACTOR; ++segment) {
+        vector<tuple<int, string, DocumentStatus, vector<int>>> documents;
+        for (size_t i = 0; i < SEGMENT_SIZE; ++i) {
+            const int id = static_cast<int>(segment * SEGMENT_SIZE + i);
+            documents.push_back({ id, "w"s + to_string(id % 97) + " w"s + to_string(id % 13), DocumentStatus::ACTUAL, { id % 10 } });
+        }
+        search_server.AddDocuments(execution::par, documents);
+    }
+    search_server.RemoveDocuments({ 0, 1, 2, 3 });
+    const auto cache = make_shared<ResultCache>(10);
+    search_server.SetResultCache(cache);
+
+    const vector<Document> expected = search_server.FindTopDocuments("w5 w6 -w7"s);
+    const size_t segment_count = search_server.GetSegmentCount();
+    const uint64_t generation = search_server.GetGeneration();
+    //Merges and compaction rewrite segments but keep the generation - and the cached result, which is still right
+    search_server.MergeSegments();
+    ASSERT(search_server.GetSegmentCount() < segment_count);
+    search_server.Compact();
+    ASSERT_EQUAL(search_server.GetGeneration(), generation);
+
+    const size_t hit_count = cache->GetHitCount();
+    AssertEqualDocuments(search_server.FindTopDocuments("w5 w6 -w7"s), expected, "cached"s);
+    ASSERT_EQUAL(cache->GetHitCount(), hit_count + 1);
+    SearchServer uncached = search_server;
+    uncached.SetResultCache(nullptr);
+    AssertEqualDocuments(uncached.FindTopDocuments("w5 w6 -w7"s), expected, "recomputed"s);
+}
+
+void TestResultCacheSkipsStatefulPredicates() {
+    SearchServer search_server("and"s);
+    const auto cache = make_shared<ResultCache>(10);
+    search_server.SetResultCache(cache);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat dog"s, DocumentStatus::ACTUAL, { 2 });
+
+    int wanted_parity = 0;
+    const auto has_parity = [&wanted_parity](int id, DocumentStatus, int) { return id % 2 == wanted_parity; };
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, has_parity).front().id, 2);
+    wanted_parity = 1;
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, has_parity).front().id, 1);
+    ASSERT_EQUAL(cache->GetHitCount() + cache->GetMissCount(), 0u);
+    ASSERT_EQUAL(cache->GetSize(), 0u);
+
+    const auto is_odd = [](int id, DocumentStatus, int) { return id % 2 == 1; };
+    search_server.FindTopDocuments("cat"s, is_odd);
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, is_odd).front().id, 1);
+    ASSERT_EQUAL(cache->GetHitCount(), 1u);
+    ASSERT_EQUAL(cache->GetSize(), 1u);
+}
+
+ResultCache::Key MakeCacheKey(const string& query) {
+    return { query, DocumentStatus::ACTUAL, 5, false };
+}
+
+void TestResultCacheEvictsLeastRecentlyUsed() {
+    ResultCache cache(2);
+    cache.Insert(MakeCacheKey("a"s), 1, { { 1, 0.5, 1 } });
+    cache.Insert(MakeCacheKey("b"s), 1, { { 2, 0.5, 1 } });
+    ASSERT(cache.Find(MakeCacheKey("a"s), 1).has_value());
+    cache.Insert(MakeCacheKey("c"s), 1, { { 3, 0.5, 1 } });
+    ASSERT_EQUAL(cache.GetSize(), 2u);
+    ASSERT(!cache.Find(MakeCacheKey("b"s), 1).has_value());
+    ASSERT_EQUAL(cache.Find(MakeCacheKey("a"s), 1)->front().id, 1);
+    ASSERT_EQUAL(cache.Find(MakeCacheKey("c"s), 1)->front().id, 3);
+    ASSERT_EQUAL(cache.GetHitCount(), 3u);
+    ASSERT_EQUAL(cache.GetMissCount(), 1u);
+
+    ResultCache disabled(0);
+    disabled.Insert(MakeCacheKey("a"s), 1, {});
+    ASSERT_EQUAL(disabled.GetSize(), 0u);
+}
+
+void TestResultCacheKeepsNewerGenerations() {
+    ResultCache cache(4);
+    cache.Insert(MakeCacheKey("a"s), 5, { { 1, 0.5, 1 } });
+    //A reader of an older version misses but neither evicts nor replaces the newer result
+    ASSERT(!cache.Find(MakeCacheKey("a"s), 3).has_value());
+    cache.Insert(MakeCacheKey("a"s), 3, { { 2, 0.5, 1 } });
+    ASSERT_EQUAL(cache.GetSize(), 1u);
+    ASSERT_EQUAL(cache.Find(MakeCacheKey("a"s), 5)->front().id, 1);
+    //A newer generation drops the outdated result
+    ASSERT(!cache.Find(MakeCacheKey("a"s), 7).has_value());
+    ASSERT_EQUAL(cache.GetSize(), 0u);
+    cache.Insert(MakeCacheKey("a"s), 5, { { 1, 0.5, 1 } });
+    cache.Insert(MakeCacheKey("a"s), 7, { { 3, 0.5, 1 } });
+    ASSERT_EQUAL(cache.Find(MakeCacheKey("a"s), 7)->front().id, 3);
+    ASSERT(!cache.Find(MakeCacheKey("a"s), 5).has_value());
+}
+
+void TestConcurrentRequestQueueLapOrder() {
+    const uint64_t last = ConcurrentRequestQueue::LAP_TAG_COUNT;
+    ASSERT(ConcurrentRequestQueue::IsLaterLap(1, 0));
+    ASSERT(ConcurrentRequestQueue::IsLaterLap(2, 1));
+    ASSERT(!ConcurrentRequestQueue::IsLaterLap(1, 2));
+    ASSERT(!ConcurrentRequestQueue::IsLaterLap(5, 5));
+    //Tags wrap around: the first tag follows the last one
+    ASSERT(ConcurrentRequestQueue::IsLaterLap(1, last));
+    ASSERT(!ConcurrentRequestQueue::IsLaterLap(last, 1));
+    ASSERT(ConcurrentRequestQueue::IsLaterLap(3, last - 3));
+}
+
+void TestConcurrentRequestQueueWindow() {
+    SearchServer search_server("and"s);
+    ConcurrentRequestQueue request_queue(search_server, 3);
+    for (size_t result_count : { 0, 0, 1, 2, 3 }) {
+        request_queue.RecordRequest(chrono::nanoseconds(result_count), result_count);
+    }
+    ASSERT_EQUAL(request_queue.GetTotalRequests(), 5u);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+    request_queue.RecordRequest(chrono::nanoseconds(0), 0);
+    ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+    const RequestStats stats = request_queue.GetStats();
+    ASSERT_EQUAL(stats.request_count, 3u);
+    ASSERT_EQUAL(stats.no_result_count, 1u);
+
+    //Once the writers finish, every slot holds the latest lap written to it: a late write
+    //of an earlier lap must not replace it
+    ConcurrentRequestQueue shared_queue(search_server, 7);
+    const size_t thread_count = 4;
+    const size_t request_count = 20000;
+    vector<future<void>> futures;
+    for (size_t thread = 0; thread < thread_count; ++thread) {
+        futures.push_back(async(launch::async, [&shared_queue, thread] {
+            for (size_t i = 0; i < request_count; ++i) {
+                shared_queue.RecordRequest(chrono::nanoseconds(i), thread);
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    ASSERT_EQUAL(shared_queue.GetTotalRequests(), thread_count * request_count);
+    ASSERT_EQUAL(shared_queue.GetStats().request_count, 7u);
+}
+
+void TestBatchMatchesPerQuerySearch() {
+    mt19937 generator(17);
+    ThreadPool pool(3);
+    SearchServer search_server("and"s);
+    //Several segments and many batch ranges; repeated texts give equal relevance, so ties are checked too
+    vector<string> texts;
+    for (int id = 0; id < 40000; ++id) {
+        texts.push_back(texts.empty() || generator() % 8 != 0 ? MakeRandomText(generator, 3 + generator() % 10, 1500)
+            : texts[generator() % texts.size()]);
+        search_server.AddDocument(id, texts.back(), static_cast<DocumentStatus>(generator() % 3 == 0 ? 1 : 0),
+            { static_cast<int>(generator() % 3) });
+    }
+    for (int id = 0; id < 40000; id += 7) {
+        search_server.RemoveDocument(id);
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 300; ++i) {
+        string query = MakeRandomText(generator, 1 + generator() % 5, 1500);
+        if (generator() % 3 == 0) {
+            query += "-"s + MakeRandomText(generator, 1, 300);
+        }
+        queries.push_back(query);
+    }
+    //Repeated queries and a word that is in no document
+    queries.push_back(queries.front());
+    queries.push_back("w99999"s);
+    const vector<string_view> batch(queries.begin(), queries.end());
+
+    for (const size_t max_count : { 1, 5, 20 }) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT }) {
+            const auto seq_results = search_server.FindTopDocumentsBatch(execution::seq, batch, status, max_count);
+            const auto pool_results = search_server.FindTopDocumentsBatch(pool.GetPolicy(), batch, status, max_count);
+            ASSERT_EQUAL(seq_results.size(), queries.size());
+            ASSERT_EQUAL(pool_results.size(), queries.size());
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const vector<Document> expected = search_server.FindTopDocuments(execution::seq, queries[i], status, max_count);
+                AssertEqualDocuments(seq_results[i], expected, "batch "s + queries[i]);
+                AssertEqualDocuments(pool_results[i], expected, "pool batch "s + queries[i]);
+            }
+        }
+    }
+
+    const vector<string> process_queries(queries.begin(), queries.end());
+    const auto batched = ProcessQueriesBatched(search_server, process_queries, pool);
+    const auto one_by_one = ProcessQueries(search_server, process_queries, pool);
+    ASSERT_EQUAL(batched.size(), one_by_one.size());
+    for (size_t i = 0; i < batched.size(); ++i) {
+        AssertEqualDocuments(batched[i], one_by_one[i], queries[i]);
+    }
+}
+
+SearchServer MakeAsyncTestServer() {
+    SearchServer search_server("and"s);
+    mt19937 generator(20);
+    for (int id = 0; id < 30000; ++id) {
+        search_server.AddDocument(id, MakeRandomText(generator, 3 + generator() % 10, 2000),
+            DocumentStatus::ACTUAL, { id % 11 });
+    }
+    return search_server;
+}
+
+bool IsReady(const future<QueryResponse>& response) {
+    return response.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+
+void TestAsyncSearchServerStatuses() {
+    const SearchServer search_server = MakeAsyncTestServer();
+    ThreadPool pool(1);
+    AsyncSearchServer async_server(search_server, 16, pool);
+    const vector<string> queries = { "w1 w7 w30"s, "w2 -w3 w500"s, "w4 w5 w6 w7 w8"s };
+
+    for (const string& query : queries) {
+        const QueryResponse response = async_server.SubmitQuery(query, chrono::hours(1)).get();
+        ASSERT(response.status == QueryStatus::COMPLETE);
+        AssertEqualDocuments(response.documents, search_server.FindTopDocuments(query), query);
+    }
+
+    future<QueryResponse> expired = async_server.SubmitQuery(queries[0], AsyncSearchServer::Clock::now() - chrono::seconds(1));
+    ASSERT(IsReady(expired));
+    const QueryResponse expired_response = expired.get();
+    ASSERT(expired_response.status == QueryStatus::EXPIRED);
+    ASSERT(expired_response.documents.empty());
+
+    //A budget shorter than the search but longer than the wait for a worker cuts the search short.
+    //The wait is not under our control, so the budget is halved until such a search happens
+    const string long_query = "w0 w1 w2 w3 w4 w5 w6 w7 w8 w9"s;
+    const vector<Document> expected = search_server.FindTopDocuments(long_query);
+    size_t partial_count = 0;
+    for (auto budget = chrono::microseconds(100000); budget.count() > 0 && partial_count == 0; budget /= 2) {
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            const QueryResponse response = async_server.SubmitQuery(long_query, budget).get();
+            if (response.status == QueryStatus::COMPLETE) {
+                AssertEqualDocuments(response.documents, expected, long_query);
+            }
+            else if (response.status == QueryStatus::PARTIAL) {
+                ++partial_count;
+                ASSERT(response.documents.size() <= MAX_RESULT_DOCUMENT_COUNT);
+                ASSERT(is_sorted(response.documents.begin(), response.documents.end(),
+                    [](const Document& lhs, const Document& rhs) { return lhs.relevance > rhs.relevance; }));
+            }
+            else {
+                ASSERT(response.status == QueryStatus::EXPIRED);
+                ASSERT(response.documents.empty());
+            }
+        }
+    }
+    ASSERT(partial_count > 0);
+
+    const AsyncSearchServer::Stats stats = async_server.GetStats();
+    ASSERT_EQUAL(stats.partial, partial_count);
+    ASSERT(stats.complete >= queries.size());
+    ASSERT(stats.expired >= 1u);
+    ASSERT_EQUAL(stats.rejected, 0u);
+    ASSERT_EQUAL(stats.failed, 0u);
+}
+
+void TestAsyncSearchServerOverload() {
+    using Clock = AsyncSearchServer::Clock;
+    const SearchServer search_server = MakeAsyncTestServer();
+    ThreadPool pool(1);
+    //The only worker is busy until release, so submitted requests stay in the queues
+    promise<void> started;
+    promise<void> release;
+    shared_future<void> released = release.get_future().share();
+    pool.Submit([&started, released] {
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+
+    const string query = "w1 w7 w30"s;
+    const vector<Document> expected = search_server.FindTopDocuments(query);
+
+    //A full queue without expired requests rejects a new one at once
+    AsyncSearchServer full_server(search_server, 2, pool);
+    vector<future<QueryResponse>> accepted;
+    accepted.push_back(full_server.SubmitQuery(query, chrono::hours(1)));
+    accepted.push_back(full_server.SubmitQuery(query, chrono::hours(1)));
+    future<QueryResponse> rejected = full_server.SubmitQuery(query, chrono::hours(1));
+    ASSERT(IsReady(rejected));
+    ASSERT(rejected.get().status == QueryStatus::REJECTED);
+    ASSERT_EQUAL(full_server.GetQueueSize(), 2u);
+
+    //A full queue drops its expired requests to make room for a new one
+    AsyncSearchServer dropping_server(search_server, 2, pool);
+    accepted.push_back(dropping_server.SubmitQuery(query, chrono::hours(1)));
+    const Clock::time_point deadline = Clock::now() + chrono::milliseconds(5);
+    future<QueryResponse> dropped = dropping_server.SubmitQuery(query, deadline);
+    this_thread::sleep_until(deadline + chrono::milliseconds(1));
+    ASSERT(!IsReady(dropped));
+    accepted.push_back(dropping_server.SubmitQuery(query, chrono::hours(1)));
+    ASSERT(IsReady(dropped));
+    ASSERT(dropped.get().status == QueryStatus::EXPIRED);
+    ASSERT_EQUAL(dropping_server.GetQueueSize(), 2u);
+
+    //A request whose deadline passes in a queue that is not full is dropped when a worker takes it
+    AsyncSearchServer waiting_server(search_server, 4, pool);
+    const Clock::time_point waiting_deadline = Clock::now() + chrono::milliseconds(5);
+    future<QueryResponse> waiting = waiting_server.SubmitQuery(query, waiting_deadline);
+    this_thread::sleep_until(waiting_deadline + chrono::milliseconds(1));
+    ASSERT(!IsReady(waiting));
+
+    release.set_value();
+    for (future<QueryResponse>& response : accepted) {
+        const QueryResponse result = response.get();
+        ASSERT(result.status == QueryStatus::COMPLETE);
+        AssertEqualDocuments(result.documents, expected, query);
+    }
+    ASSERT(waiting.get().status == QueryStatus::EXPIRED);
+
+    const AsyncSearchServer::Stats full_stats = full_server.GetStats();
+    ASSERT_EQUAL(full_stats.complete, 2u);
+    ASSERT_EQUAL(full_stats.rejected, 1u);
+    const AsyncSearchServer::Stats dropping_stats = dropping_server.GetStats();
+    ASSERT_EQUAL(dropping_stats.complete, 2u);
+    ASSERT_EQUAL(dropping_stats.expired, 1u);
+    ASSERT_EQUAL(waiting_server.GetStats().expired, 1u);
+    ASSERT_EQUAL(waiting_server.GetStats().complete, 0u);
+}
+
 int main() {
     TestRunner tr;
     RUN_TEST(tr, TestConcurrentUpdate);
     RUN_TEST(tr, TestReadAndWrite);
     RUN_TEST(tr, TestSpeedup);
+    RUN_TEST(tr, TestZeroResultCount);
+    RUN_TEST(tr, TestSnapshotRoundTrip);
+    RUN_TEST(tr, TestSnapshotRejectsCorruptFiles);
+    RUN_TEST(tr, TestCompactDropsDeletedDocuments);
+    RUN_TEST(tr, TestMergeDropsDeadTerms);
+    RUN_TEST(tr, TestSearchMatchesBruteForce);
+    RUN_TEST(tr, TestResultCacheInvalidation);
+    RUN_TEST(tr, TestResultCacheSurvivesMerges);
+    RUN_TEST(tr, TestResultCacheSkipsStatefulPredicates);
+    RUN_TEST(tr, TestResultCacheEvictsLeastRecentlyUsed);
+    RUN_TEST(tr, TestResultCacheKeepsNewerGenerations);
+    RUN_TEST(tr, TestConcurrentRequestQueueLapOrder);
+    RUN_TEST(tr, TestConcurrentRequestQueueWindow);
+    RUN_TEST(tr, TestAsyncSearchServerStatuses);
+    RUN_TEST(tr, TestAsyncSearchServerOverload);
+    RUN_TEST(tr, TestBatchMatchesPerQuerySearch);
 }
\ No newline at end of file
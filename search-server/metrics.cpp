@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "metrics.h"
+
+
+namespace {
+
+size_t GetHighestBit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return index;
+#else
+    return 63 - static_cast<size_t>(__builtin_clzll(value));
+#endif
+}
+
+std::atomic<bool> is_metrics_enabled{ false };
+
+//Гистограмма потока. Пишет в неё только свой поток, поэтому счётчики увеличиваются обычной записью,
+//без атомарного сложения; атомарность нужна, только чтобы сборщик читал целые значения
+class ThreadHistogram {
+public:
+    ThreadHistogram() {
+        for (std::atomic<uint64_t>& count : counts_) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Record(uint64_t value) {
+        std::atomic<uint64_t>& count = counts_[Histogram::GetBucket(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void AddTo(Histogram& histogram) const {
+        for (size_t bucket = 0; bucket < Histogram::BUCKET_COUNT; ++bucket) {
+            const uint64_t count = counts_[bucket].load(std::memory_order_relaxed);
+            if (count > 0) {
+                histogram.RecordBucket(bucket, count, 0);
+            }
+        }
+        histogram.RecordBucket(0, 0, sum_.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, Histogram::BUCKET_COUNT> counts_;
+    std::atomic<uint64_t> sum_{ 0 };
+};
+
+struct ThreadMetrics {
+    std::array<ThreadHistogram, QUERY_STAGE_COUNT> stage_latencies_ns;
+    ThreadHistogram query_latency_ns;
+    ThreadHistogram postings_scanned;
+    ThreadHistogram documents_scored;
+    //Занят ли живым потоком (под Registry::mutex)
+    bool is_used = false;
+
+    void AddTo(QueryMetrics& metrics) const {
+        for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+            stage_latencies_ns[stage].AddTo(metrics.stage_latencies_ns[stage]);
+        }
+        query_latency_ns.AddTo(metrics.query_latency_ns);
+        postings_scanned.AddTo(metrics.postings_scanned);
+        documents_scored.AddTo(metrics.documents_scored);
+    }
+};
+
+//Метрики всех потоков. Метрики завершившегося потока остаются в сумме и переходят к следующему новому потоку.
+//Реестр не освобождается: потоки пулов могут завершаться уже после статических объектов
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> thread_metrics;
+    //Сумма на момент ResetQueryMetrics
+    QueryMetrics baseline;
+
+    //Сумма метрик всех потоков (под mutex)
+    QueryMetrics Sum() const {
+        QueryMetrics metrics;
+        for (const auto& metrics_of_thread : thread_metrics) {
+            metrics_of_thread->AddTo(metrics);
+        }
+        return metrics;
+    }
+};
+
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+class ThreadMetricsOwner {
+public:
+    ThreadMetrics& Get() {
+        if (metrics_ == nullptr) {
+            Registry& registry = GetRegistry();
+            std::lock_guard guard(registry.mutex);
+            for (const auto& metrics : registry.thread_metrics) {
+                if (!metrics->is_used) {
+                    metrics_ = metrics.get();
+                    break;
+                }
+            }
+            if (metrics_ == nullptr) {
+                registry.thread_metrics.push_back(std::make_unique<ThreadMetrics>());
+                metrics_ = registry.thread_metrics.back().get();
+            }
+            metrics_->is_used = true;
+        }
+        return *metrics_;
+    }
+
+    ~ThreadMetricsOwner() {
+        if (metrics_ != nullptr) {
+            std::lock_guard guard(GetRegistry().mutex);
+            metrics_->is_used = false;
+        }
+    }
+
+private:
+    ThreadMetrics* metrics_ = nullptr;
+};
+
+thread_local ThreadMetricsOwner thread_metrics;
+thread_local QueryProfile last_query_profile;
+
+}
+
+size_t Histogram::GetBucket(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const size_t shift = GetHighestBit(value) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + static_cast<size_t>((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t Histogram::GetBucketFirstValue(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+    return static_cast<uint64_t>(SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+}
+
+namespace {
+
+uint64_t GetBucketLastValue(size_t bucket) {
+    return bucket + 1 < Histogram::BUCKET_COUNT
+        ? Histogram::GetBucketFirstValue(bucket + 1) - 1
+        : std::numeric_limits<uint64_t>::max();
+}
+
+}
+
+void Histogram::Record(uint64_t value, uint64_t count) {
+    counts_[GetBucket(value)] += count;
+    count_ += count;
+    sum_ += value * count;
+}
+
+void Histogram::Merge(const Histogram& other) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+//Записи только добавляются, поэтому прошлое состояние не больше текущего; ограничение снизу - на случай
+//сбора, который прочитал корзины раньше суммы
+void Histogram::Subtract(const Histogram& other) {
+    count_ = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        counts_[bucket] -= std::min(counts_[bucket], other.counts_[bucket]);
+        count_ += counts_[bucket];
+    }
+    sum_ -= std::min(sum_, other.sum_);
+}
+
+uint64_t Histogram::GetCount() const {
+    return count_;
+}
+
+uint64_t Histogram::GetSum() const {
+    return sum_;
+}
+
+double Histogram::GetMean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_);
+}
+
+uint64_t Histogram::GetPercentile(double share) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const double rank = std::max(1.0, std::min(1.0, share) * static_cast<double>(count_));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += counts_[bucket];
+        if (static_cast<double>(seen) >= rank) {
+            return GetBucketLastValue(bucket);
+        }
+    }
+    return GetMax();
+}
+
+uint64_t Histogram::GetMax() const {
+    for (size_t bucket = BUCKET_COUNT; bucket-- > 0;) {
+        if (counts_[bucket] > 0) {
+            return GetBucketLastValue(bucket);
+        }
+    }
+    return 0;
+}
+
+uint64_t Histogram::GetBucketCount(size_t bucket) const {
+    return counts_[bucket];
+}
+
+void Histogram::RecordBucket(size_t bucket, uint64_t count, uint64_t sum) {
+    counts_[bucket] += count;
+    count_ += count;
+    sum_ += sum;
+}
+
+QueryProfile::QueryProfile()
+    : start_time_(Clock::now()) {
+    for (std::atomic<uint64_t>& stage_time : stage_times_ns_) {
+        stage_time.store(0, std::memory_order_relaxed);
+    }
+}
+
+QueryProfile::QueryProfile(const QueryProfile& other)
+    : QueryProfile() {
+    *this = other;
+}
+
+QueryProfile& QueryProfile::operator=(const QueryProfile& other) {
+    start_time_ = other.start_time_;
+    query_time_ns_ = other.query_time_ns_;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        stage_times_ns_[stage].store(other.stage_times_ns_[stage].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    postings_scanned_.store(other.GetPostingsScanned(), std::memory_order_relaxed);
+    documents_scored_.store(other.GetDocumentsScored(), std::memory_order_relaxed);
+    return *this;
+}
+
+void QueryProfile::AddStageTime(QueryStage stage, Clock::duration duration) {
+    stage_times_ns_[static_cast<size_t>(stage)].fetch_add(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()),
+        std::memory_order_relaxed);
+}
+
+void QueryProfile::AddPostingsScanned(uint64_t count) {
+    postings_scanned_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void QueryProfile::AddDocumentsScored(uint64_t count) {
+    documents_scored_.fetch_add(count, std::memory_order_relaxed);
+}
+
+uint64_t QueryProfile::GetStageTimeNs(QueryStage stage) const {
+    return stage_times_ns_[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+}
+
+uint64_t QueryProfile::GetQueryTimeNs() const {
+    return query_time_ns_;
+}
+
+uint64_t QueryProfile::GetPostingsScanned() const {
+    return postings_scanned_.load(std::memory_order_relaxed);
+}
+
+uint64_t QueryProfile::GetDocumentsScored() const {
+    return documents_scored_.load(std::memory_order_relaxed);
+}
+
+void QueryProfile::Finish() {
+    query_time_ns_ = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count());
+    ThreadMetrics& metrics = thread_metrics.Get();
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        metrics.stage_latencies_ns[stage].Record(stage_times_ns_[stage].load(std::memory_order_relaxed));
+    }
+    metrics.query_latency_ns.Record(query_time_ns_);
+    metrics.postings_scanned.Record(GetPostingsScanned());
+    metrics.documents_scored.Record(GetDocumentsScored());
+    last_query_profile = *this;
+}
+
+void EnableQueryMetrics(bool is_enabled) {
+    is_metrics_enabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+bool IsQueryMetricsEnabled() {
+    return is_metrics_enabled.load(std::memory_order_relaxed);
+}
+
+QueryMetrics CollectQueryMetrics() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    QueryMetrics metrics = registry.Sum();
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        metrics.stage_latencies_ns[stage].Subtract(registry.baseline.stage_latencies_ns[stage]);
+    }
+    metrics.query_latency_ns.Subtract(registry.baseline.query_latency_ns);
+    metrics.postings_scanned.Subtract(registry.baseline.postings_scanned);
+    metrics.documents_scored.Subtract(registry.baseline.documents_scored);
+    return metrics;
+}
+
+void ResetQueryMetrics() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    registry.baseline = registry.Sum();
+}
+
+const QueryProfile& GetLastQueryProfile() {
+    return last_query_profile;
+}
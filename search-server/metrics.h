@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+//Этапы поиска, время которых собирается по запросам
+enum class QueryStage {
+    PARSE,              //разбор запроса
+    MINUS_FILTERING,    //сбор документов с минус-словами
+    POSTING_TRAVERSAL,  //обход списков вхождений и подсчёт релевантности
+    RANKING,            //слияние наборов лучших и сортировка выдачи
+};
+
+const size_t QUERY_STAGE_COUNT = 4;
+
+//Гистограмма в духе HDR: значения до 2^SUB_BUCKET_BITS считаются точно, большие попадают
+//в корзины шириной не больше 1/2^SUB_BUCKET_BITS своего значения (погрешность ~3%) -
+//так на все 64-битные значения хватает ~2000 корзин
+class Histogram {
+public:
+    static const size_t SUB_BUCKET_BITS = 5;
+    static const size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    //Корзина значения и наименьшее значение корзины
+    static size_t GetBucket(uint64_t value);
+    static uint64_t GetBucketFirstValue(size_t bucket);
+
+    void Record(uint64_t value, uint64_t count = 1);
+    void Merge(const Histogram& other);
+    //Вычитаем гистограмму, записанную раньше (other - её прошлое состояние)
+    void Subtract(const Histogram& other);
+
+    uint64_t GetCount() const;
+    uint64_t GetSum() const;
+    double GetMean() const;
+    //Значение, не больше которого share значений (наибольшее значение корзины); 0 у пустой гистограммы
+    uint64_t GetPercentile(double share) const;
+    //Наибольшее значение корзины самого большого значения
+    uint64_t GetMax() const;
+
+    uint64_t GetBucketCount(size_t bucket) const;
+    //Добавляем count значений корзины bucket, сумма которых sum (для сбора гистограмм, хранящихся по корзинам)
+    void RecordBucket(size_t bucket, uint64_t count, uint64_t sum);
+
+private:
+    std::vector<uint64_t> counts_ = std::vector<uint64_t>(BUCKET_COUNT);
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+};
+
+//Метрики поиска: время этапов (нс) и объём работы на запрос. Суммируются по всем потокам
+struct QueryMetrics {
+    std::array<Histogram, QUERY_STAGE_COUNT> stage_latencies_ns;
+    //Время всего поиска (без ожидания в очередях)
+    Histogram query_latency_ns;
+    //Просмотренные вхождения и документы, у которых посчитана релевантность
+    Histogram postings_scanned;
+    Histogram documents_scored;
+
+    const Histogram& GetStageLatencies(QueryStage stage) const {
+        return stage_latencies_ns[static_cast<size_t>(stage)];
+    }
+};
+
+//Профиль одного запроса. Этапы параллельного поиска добавляют время из своих потоков, поэтому у него
+//время этапа - суммарное время потоков, а не длительность. Finish записывает профиль в метрики потока
+class QueryProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueryProfile();
+    //Копия - снимок значений (например, для GetLastQueryProfile)
+    QueryProfile(const QueryProfile& other);
+    QueryProfile& operator=(const QueryProfile& other);
+
+    void AddStageTime(QueryStage stage, Clock::duration duration);
+    void AddPostingsScanned(uint64_t count);
+    void AddDocumentsScored(uint64_t count);
+
+    uint64_t GetStageTimeNs(QueryStage stage) const;
+    uint64_t GetQueryTimeNs() const;
+    uint64_t GetPostingsScanned() const;
+    uint64_t GetDocumentsScored() const;
+
+    //Запрос закончен: фиксируем его время и добавляем профиль в гистограммы текущего потока
+    void Finish();
+
+private:
+    Clock::time_point start_time_;
+    uint64_t query_time_ns_ = 0;
+    std::array<std::atomic<uint64_t>, QUERY_STAGE_COUNT> stage_times_ns_;
+    std::atomic<uint64_t> postings_scanned_{ 0 };
+    std::atomic<uint64_t> documents_scored_{ 0 };
+};
+
+//Сбор метрик включается и выключается на ходу; выключенный стоит одной проверки флага на запрос
+void EnableQueryMetrics(bool is_enabled);
+bool IsQueryMetricsEnabled();
+
+//Сумма метрик всех потоков с последнего ResetQueryMetrics. Потоки пишут каждый в свои гистограммы
+//без блокировок, а сбор их только читает, поэтому запросы, идущие во время сбора, могут попасть в него частично
+QueryMetrics CollectQueryMetrics();
+//Начинаем отсчёт метрик заново (записанное потоками не стирается, а запоминается и вычитается при сборе)
+void ResetQueryMetrics();
+
+//Профиль последнего запроса, законченного в текущем потоке
+const QueryProfile& GetLastQueryProfile();
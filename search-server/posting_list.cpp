@@ -0,0 +1,358 @@
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "posting_list.h"
+
+using namespace std::string_literals;
+
+
+namespace {
+
+//Значений в одной полосе блока: полоса из ROW_COUNT значений по bits бит занимает ровно bits слов
+constexpr size_t ROW_COUNT = PostingList::BLOCK_SIZE / PostingList::LANE_COUNT;
+
+uint8_t BitWidth(uint32_t value) {
+    uint8_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+//Значение row * LANE_COUNT + lane попадает в полосу lane; слово j полосы лежит в words[j * LANE_COUNT + lane]
+void Pack(const uint32_t* values, uint8_t bits, uint32_t* words) {
+    //Все значения нулевые - блок не занимает ни одного слова
+    if (bits == 0) {
+        return;
+    }
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        const size_t bit = row * bits;
+        const size_t word = bit / 32;
+        const size_t shift = bit % 32;
+        for (size_t lane = 0; lane < PostingList::LANE_COUNT; ++lane) {
+            const uint64_t value = values[row * PostingList::LANE_COUNT + lane];
+            words[word * PostingList::LANE_COUNT + lane] |= static_cast<uint32_t>(value << shift);
+            if (shift + bits > 32) {
+                words[(word + 1) * PostingList::LANE_COUNT + lane] |= static_cast<uint32_t>(value >> (32 - shift));
+            }
+        }
+    }
+}
+
+//Ширина и номер строки известны при компиляции: сдвиги и маски - константы, а одинаковые
+//операции над LANE_COUNT полосами компилятор выполняет одной векторной инструкцией
+template <uint8_t BITS, size_t ROW, size_t LANE>
+void UnpackValue(const uint32_t* words, uint32_t* values) {
+    constexpr uint32_t MASK = BITS == 32 ? ~uint32_t{ 0 } : (uint32_t{ 1 } << BITS) - 1;
+    constexpr size_t WORD = ROW * BITS / 32;
+    constexpr size_t SHIFT = ROW * BITS % 32;
+    uint32_t value = words[WORD * PostingList::LANE_COUNT + LANE] >> SHIFT;
+    if constexpr (SHIFT + BITS > 32) {
+        value |= words[(WORD + 1) * PostingList::LANE_COUNT + LANE] << (32 - SHIFT);
+    }
+    values[ROW * PostingList::LANE_COUNT + LANE] = value & MASK;
+}
+
+template <uint8_t BITS, size_t ROW, size_t... Lanes>
+void UnpackRow(const uint32_t* words, uint32_t* values, std::index_sequence<Lanes...>) {
+    (UnpackValue<BITS, ROW, Lanes>(words, values), ...);
+}
+
+template <uint8_t BITS, size_t... Rows>
+void UnpackRows(const uint32_t* words, uint32_t* values, std::index_sequence<Rows...>) {
+    (UnpackRow<BITS, Rows>(words, values, std::make_index_sequence<PostingList::LANE_COUNT>{}), ...);
+}
+
+template <uint8_t BITS>
+void UnpackFixed(const uint32_t* words, uint32_t* values) {
+    if constexpr (BITS == 0) {
+        std::fill(values, values + PostingList::BLOCK_SIZE, 0);
+    }
+    else {
+        //Локальная копия не пересекается с values - компилятор может группировать загрузки полос
+        uint32_t packed[BITS * PostingList::LANE_COUNT];
+        std::copy(words, words + BITS * PostingList::LANE_COUNT, packed);
+        UnpackRows<BITS>(packed, values, std::make_index_sequence<ROW_COUNT>{});
+    }
+}
+
+using UnpackFunction = void (*)(const uint32_t*, uint32_t*);
+
+template <size_t... Bits>
+constexpr std::array<UnpackFunction, sizeof...(Bits)> MakeUnpackers(std::index_sequence<Bits...>) {
+    return { &UnpackFixed<static_cast<uint8_t>(Bits)>... };
+}
+
+//Распаковка для каждой ширины от 0 до 32 бит
+constexpr std::array<UnpackFunction, 33> UNPACKERS = MakeUnpackers(std::make_index_sequence<33>{});
+
+void Unpack(const uint32_t* words, uint8_t bits, uint32_t* values) {
+    UNPACKERS[bits](words, values);
+}
+
+} // namespace
+
+
+uint32_t TermFrequencyTable::Encode(double tf) {
+    const auto [it, inserted] = value_to_code_.emplace(tf, static_cast<uint32_t>(values_.size()));
+    if (inserted) {
+        values_.push_back(tf);
+    }
+    return it->second;
+}
+
+uint32_t TermFrequencyTable::Find(double tf) const {
+    const auto it = value_to_code_.find(tf);
+    return it == value_to_code_.end() ? NO_CODE : it->second;
+}
+
+// Узел хеш-таблицы - значение, указатель на следующий узел и сохранённый хеш
+size_t TermFrequencyTable::GetMemoryUsage() const {
+    return values_.capacity() * sizeof(double)
+        + value_to_code_.size() * (sizeof(std::pair<const double, uint32_t>) + 2 * sizeof(void*))
+        + value_to_code_.bucket_count() * sizeof(void*);
+}
+
+
+void PostingList::PushBack(uint32_t document_index, double tf, TermFrequencyTable& frequencies) {
+    PushBackCode(document_index, frequencies.Encode(tf), frequencies);
+}
+
+void PostingList::PushBackCode(uint32_t document_index, uint32_t code, const TermFrequencyTable& frequencies) {
+    const double tf = frequencies.Decode(code);
+    tail_document_indices_.push_back(document_index);
+    tail_codes_.push_back(code);
+    tail_max_tf_ = std::max(tail_max_tf_, tf);
+    max_tf_ = std::max(max_tf_, tf);
+    ++document_count_;
+
+    //Хвост заполнился - сжимаем его в новый блок
+    if (tail_document_indices_.size() == BLOCK_SIZE) {
+        Detach();
+        blocks_.push_back(EncodeBlock(tail_document_indices_.data(), tail_codes_.data(), BLOCK_SIZE, tail_max_tf_, words_));
+        tail_document_indices_.clear();
+        tail_codes_.clear();
+        tail_max_tf_ = 0.0;
+    }
+}
+
+void PostingList::Seal() {
+    if (!tail_document_indices_.empty()) {
+        Detach();
+        blocks_.push_back(EncodeBlock(tail_document_indices_.data(), tail_codes_.data(), tail_document_indices_.size(),
+            tail_max_tf_, words_));
+        tail_document_indices_.clear();
+        tail_codes_.clear();
+        tail_max_tf_ = 0.0;
+    }
+    blocks_.shrink_to_fit();
+    words_.shrink_to_fit();
+    tail_document_indices_.shrink_to_fit();
+    tail_codes_.shrink_to_fit();
+}
+
+// Блоки из снимка лежат в отображённом файле и не считаются
+size_t PostingList::GetMemoryUsage() const {
+    return blocks_.capacity() * sizeof(Block) + words_.capacity() * sizeof(uint32_t)
+        + (tail_document_indices_.capacity() + tail_codes_.capacity()) * sizeof(uint32_t);
+}
+
+bool PostingList::Contains(uint32_t document_index) const {
+    const size_t block = FindBlock(0, document_index);
+    if (block == GetBlockCount() || GetFirstDocumentIndex(block) > document_index) {
+        return false;
+    }
+    uint32_t document_indices[BLOCK_SIZE];
+    uint32_t codes[BLOCK_SIZE];
+    const size_t size = DecodeBlock(block, document_indices, codes);
+    return std::binary_search(document_indices, document_indices + size, document_index);
+}
+
+size_t PostingList::FindBlock(size_t block, uint32_t document_index) const {
+    const Block* blocks = GetBlocks();
+    const size_t block_count = GetCompressedBlockCount();
+    const Block* it = std::partition_point(blocks + std::min(block, block_count), blocks + block_count,
+        [document_index](const Block& candidate) { return candidate.last_document_index < document_index; });
+    if (it != blocks + block_count) {
+        return static_cast<size_t>(it - blocks);
+    }
+    //Сжатые блоки кончились - остаётся хвост, если он есть и доходит до нужного индекса
+    if (!tail_document_indices_.empty() && tail_document_indices_.back() >= document_index) {
+        return block_count;
+    }
+    return GetBlockCount();
+}
+
+size_t PostingList::DecodeBlock(size_t block, uint32_t* document_indices, uint32_t* codes) const {
+    if (block == GetCompressedBlockCount()) {
+        std::copy(tail_document_indices_.begin(), tail_document_indices_.end(), document_indices);
+        std::copy(tail_codes_.begin(), tail_codes_.end(), codes);
+        return tail_document_indices_.size();
+    }
+    const Block& header = GetBlocks()[block];
+    const uint32_t* words = GetWords() + header.offset;
+    Unpack(words, header.delta_bits, document_indices);
+    Unpack(words + LANE_COUNT * header.delta_bits, header.code_bits, codes);
+    uint32_t document_index = header.first_document_index;
+    for (size_t i = 0; i < header.size; ++i) {
+        document_index += document_indices[i];
+        document_indices[i] = document_index;
+    }
+    return header.size;
+}
+
+// Место под все блоки выделяется заранее, поэтому адреса в общих массивах не меняются, пока их заполняют.
+// Смещения блоков считаются от начала данных своего списка и переносятся как есть
+std::shared_ptr<const PostingList::PackedBlocks> PostingList::PackBlocks(std::vector<PostingList>& lists) {
+    auto packed = std::make_shared<PackedBlocks>();
+    size_t block_count = 0;
+    size_t word_count = 0;
+    for (const PostingList& postings : lists) {
+        if (postings.mapped_blocks_ == nullptr) {
+            block_count += postings.blocks_.size();
+            word_count += postings.words_.size();
+        }
+    }
+    packed->blocks.reserve(block_count);
+    packed->words.reserve(word_count);
+
+    for (PostingList& postings : lists) {
+        if (postings.mapped_blocks_ != nullptr || postings.blocks_.empty()) {
+            continue;
+        }
+        postings.mapped_blocks_ = packed->blocks.data() + packed->blocks.size();
+        postings.mapped_block_count_ = postings.blocks_.size();
+        postings.mapped_words_ = packed->words.data() + packed->words.size();
+        postings.mapped_word_count_ = postings.words_.size();
+        packed->blocks.insert(packed->blocks.end(), postings.blocks_.begin(), postings.blocks_.end());
+        packed->words.insert(packed->words.end(), postings.words_.begin(), postings.words_.end());
+        postings.blocks_.clear();
+        postings.blocks_.shrink_to_fit();
+        postings.words_.clear();
+        postings.words_.shrink_to_fit();
+    }
+    return packed;
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.Write(static_cast<uint64_t>(document_count_));
+    writer.Write(max_tf_);
+    writer.Write(static_cast<uint64_t>(GetCompressedBlockCount()));
+    writer.WriteArray(GetBlocks(), GetCompressedBlockCount());
+    const size_t word_count = GetWordCount();
+    writer.Write(static_cast<uint64_t>(word_count));
+    writer.WriteArray(GetWords(), word_count);
+    writer.Write(static_cast<uint64_t>(tail_document_indices_.size()));
+    writer.WriteArray(tail_document_indices_.data(), tail_document_indices_.size());
+    writer.WriteArray(tail_codes_.data(), tail_codes_.size());
+    writer.Write(tail_max_tf_);
+}
+
+PostingList PostingList::Open(SnapshotReader& reader) {
+    PostingList postings;
+    postings.document_count_ = reader.Read<uint64_t>();
+    postings.max_tf_ = reader.Read<double>();
+    postings.mapped_block_count_ = reader.Read<uint64_t>();
+    postings.mapped_blocks_ = reader.ReadArray<Block>(postings.mapped_block_count_);
+    postings.mapped_word_count_ = reader.Read<uint64_t>();
+    postings.mapped_words_ = reader.ReadArray<uint32_t>(postings.mapped_word_count_);
+    //Распаковщики есть для ширины до 32 бит; данные блока должны лежать внутри данных списка
+    for (size_t block = 0; block < postings.mapped_block_count_; ++block) {
+        const Block& header = postings.mapped_blocks_[block];
+        if (header.size == 0 || header.size > BLOCK_SIZE || header.delta_bits > 32 || header.code_bits > 32
+            || uint64_t(header.offset) + LANE_COUNT * (header.delta_bits + header.code_bits) > postings.mapped_word_count_) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+    }
+    //Хвост меняется при каждом добавлении - его копируем сразу
+    const uint64_t tail_size = reader.Read<uint64_t>();
+    if (tail_size >= BLOCK_SIZE) {
+        throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+    }
+    const uint32_t* tail_document_indices = reader.ReadArray<uint32_t>(tail_size);
+    const uint32_t* tail_codes = reader.ReadArray<uint32_t>(tail_size);
+    postings.tail_document_indices_.assign(tail_document_indices, tail_document_indices + tail_size);
+    postings.tail_codes_.assign(tail_codes, tail_codes + tail_size);
+    postings.tail_max_tf_ = reader.Read<double>();
+    return postings;
+}
+
+bool PostingList::IsValid(uint32_t first_index, uint32_t end_index, const TermFrequencyTable& frequencies) const {
+    uint32_t document_indices[BLOCK_SIZE];
+    uint32_t codes[BLOCK_SIZE];
+    size_t document_count = 0;
+    //Следующий допустимый индекс: индексы строго возрастают по всему списку
+    uint64_t next_index = first_index;
+    for (size_t block = 0; block < GetBlockCount(); ++block) {
+        //Разности складываются по модулю 2^32 - переполнение видно по последнему индексу блока
+        uint64_t expected_index = GetFirstDocumentIndex(block);
+        const size_t size = DecodeBlock(block, document_indices, codes);
+        for (size_t i = 0; i < size; ++i) {
+            if (i > 0) {
+                expected_index += document_indices[i] - document_indices[i - 1];
+            }
+            if (document_indices[i] != expected_index || document_indices[i] < next_index || document_indices[i] >= end_index
+                || codes[i] >= frequencies.GetSize()) {
+                return false;
+            }
+            next_index = uint64_t(document_indices[i]) + 1;
+        }
+        if (document_indices[size - 1] != GetLastDocumentIndex(block)) {
+            return false;
+        }
+        document_count += size;
+    }
+    return document_count == document_count_;
+}
+
+void PostingList::Detach() {
+    if (mapped_blocks_ == nullptr) {
+        return;
+    }
+    blocks_.assign(mapped_blocks_, mapped_blocks_ + mapped_block_count_);
+    words_.assign(mapped_words_, mapped_words_ + mapped_word_count_);
+    mapped_blocks_ = nullptr;
+    mapped_words_ = nullptr;
+    mapped_block_count_ = 0;
+    mapped_word_count_ = 0;
+}
+
+PostingList::Block PostingList::EncodeBlock(const uint32_t* document_indices, const uint32_t* codes, size_t size, double max_tf,
+    std::vector<uint32_t>& words) {
+    //Первая разность считается от первого индекса блока и равна нулю; хвост блока добиваем нулями
+    uint32_t deltas[BLOCK_SIZE] = {};
+    uint32_t padded_codes[BLOCK_SIZE] = {};
+    uint32_t max_delta = 0;
+    uint32_t max_code = 0;
+    for (size_t i = 0; i < size; ++i) {
+        deltas[i] = i == 0 ? 0 : document_indices[i] - document_indices[i - 1];
+        padded_codes[i] = codes[i];
+        max_delta = std::max(max_delta, deltas[i]);
+        max_code = std::max(max_code, codes[i]);
+    }
+
+    Block block;
+    block.first_document_index = document_indices[0];
+    block.last_document_index = document_indices[size - 1];
+    block.offset = static_cast<uint32_t>(words.size());
+    block.size = static_cast<uint8_t>(size);
+    block.delta_bits = BitWidth(max_delta);
+    block.code_bits = BitWidth(max_code);
+    block.max_tf = max_tf;
+
+    words.resize(words.size() + LANE_COUNT * (block.delta_bits + block.code_bits), 0);
+    uint32_t* block_words = words.data() + block.offset;
+    Pack(deltas, block.delta_bits, block_words);
+    Pack(padded_codes, block.code_bits, block_words + LANE_COUNT * block.delta_bits);
+    return block;
+}
+
+
+void PostingList::Cursor::Decode() {
+    size_ = postings_->DecodeBlock(block_, document_indices_, codes_);
+    position_ = 0;
+    is_decoded_ = true;
+}
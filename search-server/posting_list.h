@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "snapshot.h"
+
+
+//Таблица различных значений TF. В списках вхождений вместо TF хранится его номер в таблице
+//(квантованный TF): разных значений немного, поэтому номер занимает несколько бит,
+//а восстановленный TF в точности равен исходному
+class TermFrequencyTable {
+public:
+    //Номер, который возвращается для отсутствующего значения
+    static constexpr uint32_t NO_CODE = UINT32_MAX;
+
+    //Номер значения; новое значение добавляется в конец таблицы
+    uint32_t Encode(double tf);
+
+    //Номер значения или NO_CODE; таблица не меняется, поэтому можно звать из нескольких потоков
+    uint32_t Find(double tf) const;
+
+    double Decode(uint32_t code) const {
+        return values_[code];
+    }
+
+    //Сколько различных значений в таблице
+    size_t GetSize() const {
+        return values_.size();
+    }
+
+    //Сколько байт кучи занимает таблица (оценка)
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<double> values_;
+    std::unordered_map<double, uint32_t> value_to_code_;
+};
+
+
+//Сжатый список вхождений слова, отсортированный по внутреннему индексу документа.
+//Вхождения лежат блоками по BLOCK_SIZE: индексы документов хранятся разностями, номера TF -
+//как есть, и то и другое упаковано в минимальное для блока число бит. Значения блока разложены
+//по LANE_COUNT полосам, поэтому распаковка идёт одинаковыми сдвигами сразу для всех полос.
+//У каждого блока есть первый и последний индекс и наибольший TF: по ним блоки пропускаются
+//без распаковки. Последние вхождения (неполный блок) хранятся без сжатия.
+//У списка, открытого из снимка, сжатые блоки читаются прямо из отображённого файла,
+//а у упакованного (PackBlocks) - из общей памяти многих списков; в собственную память
+//они копируются только при первом их изменении
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+    static constexpr size_t LANE_COUNT = 4;
+
+    class Cursor;
+
+    //Сжатые блоки многих списков, лежащие подряд в двух общих массивах
+    struct PackedBlocks;
+
+    //Сколько документов в списке
+    size_t GetDocumentCount() const {
+        return document_count_;
+    }
+
+    bool IsEmpty() const {
+        return document_count_ == 0;
+    }
+
+    //Наибольший TF по документам списка. При удалении документов не уменьшается
+    //и остаётся верной (хоть и менее точной) границей
+    double GetMaxTf() const {
+        return max_tf_;
+    }
+
+    //Дописываем вхождение; индекс документа должен быть больше всех, что уже есть в списке
+    void PushBack(uint32_t document_index, double tf, TermFrequencyTable& frequencies);
+    //То же для уже закодированного TF: таблица не меняется, поэтому разные списки можно дополнять параллельно
+    void PushBackCode(uint32_t document_index, uint32_t code, const TermFrequencyTable& frequencies);
+
+    //Есть ли документ в списке
+    bool Contains(uint32_t document_index) const;
+
+
+    //Сколько байт кучи занимает список
+    size_t GetMemoryUsage() const;
+
+    //Упаковываем хвост в последний (неполный) блок и отдаём лишнюю память. Список можно дополнять и дальше
+    void Seal();
+
+    //Переносим сжатые блоки списков (кроме отображённых из снимка) в общую память: два выделения
+    //на все списки вместо двух на каждый. Хвосты остаются при списках, поэтому сначала списки запечатывают.
+    //Общая память должна жить дольше списков и их копий
+    static std::shared_ptr<const PackedBlocks> PackBlocks(std::vector<PostingList>& lists);
+
+    //Обходим вхождения с индексами из [first, last) по возрастанию: function(индекс документа, TF).
+    //Блоки распаковываются целиком в локальные массивы - для сплошного обхода это быстрее курсора
+    template <typename Function>
+    void ForEachInRange(uint32_t first, uint32_t last, const TermFrequencyTable& frequencies, Function function) const;
+
+    //Пишем список в снимок
+    void Save(SnapshotWriter& writer) const;
+    //Список, сжатые блоки которого остаются в отображённом снимке; снимок должен жить дольше списка.
+    //Заголовки блоков проверяются сразу: распаковка не выходит за данные списка
+    static PostingList Open(SnapshotReader& reader);
+    //Распаковываем весь список и проверяем, что индексы возрастают и лежат в [first_index, end_index),
+    //номера TF есть в таблице, а число вхождений совпадает с записанным
+    bool IsValid(uint32_t first_index, uint32_t end_index, const TermFrequencyTable& frequencies) const;
+
+private:
+    struct Block {
+        uint32_t first_document_index;
+        uint32_t last_document_index;
+        //Начало упакованных данных блока в words_
+        uint32_t offset;
+        uint8_t size;
+        uint8_t delta_bits;
+        uint8_t code_bits;
+        //Блоки пишутся в снимок как есть, поэтому неявного выравнивания в них нет: снимок одного индекса
+        //всегда одинаков байт в байт
+        uint8_t reserved = 0;
+        double max_tf;
+    };
+    static_assert(sizeof(Block) == 3 * sizeof(uint32_t) + 4 * sizeof(uint8_t) + sizeof(double));
+
+    //Сжатые блоки и их данные - свои, в снимке или в общей памяти
+    const Block* GetBlocks() const {
+        return mapped_blocks_ != nullptr ? mapped_blocks_ : blocks_.data();
+    }
+    size_t GetCompressedBlockCount() const {
+        return mapped_blocks_ != nullptr ? mapped_block_count_ : blocks_.size();
+    }
+    const uint32_t* GetWords() const {
+        return mapped_blocks_ != nullptr ? mapped_words_ : words_.data();
+    }
+    size_t GetWordCount() const {
+        return mapped_blocks_ != nullptr ? mapped_word_count_ : words_.size();
+    }
+
+    //Перед изменением сжатых блоков копируем их из снимка или общей памяти в собственную
+    void Detach();
+
+    //Сколько блоков видит курсор: сжатые и, если есть, несжатый хвост
+    size_t GetBlockCount() const {
+        return GetCompressedBlockCount() + (tail_document_indices_.empty() ? 0 : 1);
+    }
+    uint32_t GetFirstDocumentIndex(size_t block) const {
+        return block < GetCompressedBlockCount() ? GetBlocks()[block].first_document_index : tail_document_indices_.front();
+    }
+    uint32_t GetLastDocumentIndex(size_t block) const {
+        return block < GetCompressedBlockCount() ? GetBlocks()[block].last_document_index : tail_document_indices_.back();
+    }
+    double GetBlockMaxTf(size_t block) const {
+        return block < GetCompressedBlockCount() ? GetBlocks()[block].max_tf : tail_max_tf_;
+    }
+
+    //Первый блок из [block, GetBlockCount()), последний индекс которого не меньше заданного
+    size_t FindBlock(size_t block, uint32_t document_index) const;
+
+    //Распаковываем блок (или копируем хвост); возвращаем число вхождений
+    size_t DecodeBlock(size_t block, uint32_t* document_indices, uint32_t* codes) const;
+
+    //Упаковываем вхождения в конец words
+    static Block EncodeBlock(const uint32_t* document_indices, const uint32_t* codes, size_t size, double max_tf,
+        std::vector<uint32_t>& words);
+
+    std::vector<Block> blocks_;
+    std::vector<uint32_t> words_;
+    //Блоки списка из снимка или общей памяти; nullptr, если блоки свои
+    const Block* mapped_blocks_ = nullptr;
+    size_t mapped_block_count_ = 0;
+    const uint32_t* mapped_words_ = nullptr;
+    size_t mapped_word_count_ = 0;
+
+    std::vector<uint32_t> tail_document_indices_;
+    std::vector<uint32_t> tail_codes_;
+    double tail_max_tf_ = 0.0;
+
+    size_t document_count_ = 0;
+    double max_tf_ = 0.0;
+};
+
+
+struct PostingList::PackedBlocks {
+    std::vector<Block> blocks;
+    std::vector<uint32_t> words;
+
+    size_t GetMemoryUsage() const {
+        return blocks.capacity() * sizeof(Block) + words.capacity() * sizeof(uint32_t);
+    }
+};
+
+
+template <typename Function>
+void PostingList::ForEachInRange(uint32_t first, uint32_t last, const TermFrequencyTable& frequencies, Function function) const {
+    uint32_t document_indices[BLOCK_SIZE];
+    uint32_t codes[BLOCK_SIZE];
+    const size_t block_count = GetBlockCount();
+    for (size_t block = FindBlock(0, first); block < block_count && GetFirstDocumentIndex(block) < last; ++block) {
+        const size_t size = DecodeBlock(block, document_indices, codes);
+        size_t i = block > 0 && GetFirstDocumentIndex(block) >= first ? 0
+            : static_cast<size_t>(std::lower_bound(document_indices, document_indices + size, first) - document_indices);
+        for (; i < size && document_indices[i] < last; ++i) {
+            function(document_indices[i], frequencies.Decode(codes[i]));
+        }
+    }
+}
+
+
+//Проход по списку вхождений по возрастанию индекса документа. Блок распаковывается,
+//только когда курсор действительно читает его вхождения
+class PostingList::Cursor {
+public:
+    Cursor(const PostingList& postings, const TermFrequencyTable& frequencies)
+        : postings_(&postings)
+        , frequencies_(&frequencies)
+        , block_count_(postings.GetBlockCount()) {
+        if (!IsEnd()) {
+            Decode();
+        }
+    }
+
+    bool IsEnd() const {
+        return block_ >= block_count_;
+    }
+
+    uint32_t GetDocumentIndex() const {
+        return document_indices_[position_];
+    }
+
+    double GetTf() const {
+        return frequencies_->Decode(codes_[position_]);
+    }
+
+    void Next() {
+        if (++position_ == size_) {
+            ++block_;
+            if (!IsEnd()) {
+                Decode();
+            }
+        }
+    }
+
+    //Переходим к блоку, в котором может быть документ с индексом не меньше заданного, не распаковывая его
+    void ShallowSkipTo(uint32_t document_index) {
+        if (!IsEnd() && postings_->GetLastDocumentIndex(block_) < document_index) {
+            block_ = postings_->FindBlock(block_ + 1, document_index);
+            is_decoded_ = false;
+        }
+    }
+
+    //Переходим к первому вхождению с индексом не меньше заданного
+    void SkipTo(uint32_t document_index) {
+        ShallowSkipTo(document_index);
+        if (IsEnd()) {
+            return;
+        }
+        if (!is_decoded_) {
+            Decode();
+        }
+        position_ = static_cast<size_t>(std::lower_bound(document_indices_ + position_, document_indices_ + size_, document_index)
+            - document_indices_);
+    }
+
+    //Границы и наибольший TF текущего блока (курсор не в конце)
+    uint32_t GetBlockFirstDocumentIndex() const {
+        return postings_->GetFirstDocumentIndex(block_);
+    }
+    double GetBlockMaxTf() const {
+        return postings_->GetBlockMaxTf(block_);
+    }
+
+private:
+    void Decode();
+
+    const PostingList* postings_;
+    const TermFrequencyTable* frequencies_;
+    size_t block_count_;
+    size_t block_ = 0;
+    bool is_decoded_ = false;
+    size_t position_ = 0;
+    size_t size_ = 0;
+    uint32_t document_indices_[BLOCK_SIZE];
+    uint32_t codes_[BLOCK_SIZE];
+};
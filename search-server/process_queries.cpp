@@ -1,38 +1,191 @@
-#include <execution>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include "process_queries.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
-	const SearchServer& search_server, const std::vector<std::string>& queries) {
+	const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
 
+	LOG_TRACE("ProcessQueries");
 	std::vector<std::vector<Document>> processed_queries(queries.size());
 
-	std::transform(
-		std::execution::par,
-		queries.begin(), queries.end(), //  
-		processed_queries.begin(), //  
-		[&search_server](std::string query) {
-			return search_server.FindTopDocuments(query); //     _
+	pool.ParallelFor(
+		queries.size(),
+		[&](size_t i) {
+			processed_queries[i] = search_server.FindTopDocuments(queries[i]); // через лямбду применяем метод сёрч_сервера
 		}
 	);
 
 	return processed_queries;
 }
 
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+	const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
+
+	LOG_TRACE("ProcessQueriesBatched");
+	// запросы передаём представлениями - строки не копируются
+	const std::vector<std::string_view> query_views(queries.begin(), queries.end());
+	return search_server.FindTopDocumentsBatch(pool.GetPolicy(), query_views);
+}
+
 std::vector<Document> ProcessQueriesJoined(
-	const SearchServer& search_server, const std::vector<std::string>& queries) {
+	const SearchServer& search_server, const std::vector<std::string>& queries, ThreadPool& pool) {
 
 	std::vector<Document> processed_joined_queries;
 
-	for (std::vector<Document>& docs : ProcessQueries(search_server, queries)) {
-		std::transform(
-			docs.begin(), docs.end(),
-			back_inserter(processed_joined_queries),
-			[](Document& doc) {
-				return doc;
+	// результаты всех запросов разом не храним - документы сразу дописываются в общий вектор
+	ProcessQueriesJoinedStreamed(search_server, queries,
+		[&processed_joined_queries](const Document& doc) {
+			processed_joined_queries.push_back(doc);
+		},
+		STREAM_WINDOW_SIZE, pool
+	);
+
+	return processed_joined_queries;
+}
+
+// Результат запроса i лежит в ячейке окна i % размер окна, пока его не заберёт потребитель.
+// Задача-обработчик на пуле берёт запросы по порядку, пока в окне есть место, и завершается, когда места
+// не осталось, - она никогда не ждёт потребителя. Потребитель, забрав результат, снова запускает обработчики,
+// а будят его, как только готов именно ждущий результат.
+// Пока нужного результата нет, потребитель сам выполняет задачи пула, поэтому обработка идёт,
+// даже если потребитель - поток того же пула. Обработчик, взятый потребителем, выполняет один запрос
+// и ставит себя в пул заново - потребитель сразу проверяет, не готов ли его результат
+void ProcessQueriesStreamed(
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	const std::function<void(size_t, std::vector<Document>&)>& consumer, size_t window_size, ThreadPool& pool) {
+
+	if (queries.empty()) {
+		return;
+	}
+	LOG_TRACE("ProcessQueriesStreamed");
+	const size_t slot_count = std::min(std::max<size_t>(1, window_size), queries.size());
+	std::vector<std::vector<Document>> results(slot_count);
+	std::vector<std::exception_ptr> errors(slot_count);
+	std::vector<char> is_ready(slot_count, false);
+
+	std::mutex mutex;
+	std::condition_variable result_ready;
+	size_t next_query = 0; // следующий запрос, который возьмёт обработчик
+	size_t next_result = 0; // следующий результат, который ждёт потребитель
+	size_t runner_count = 0; // запущенные и ещё не завершённые обработчики
+	bool is_stopping = false;
+	const std::thread::id consumer_thread = std::this_thread::get_id();
+
+	// можно ли взять следующий запрос (под mutex)
+	const auto can_take = [&]() {
+		return !is_stopping && next_query < queries.size() && next_query < next_result + slot_count;
+	};
+
+	std::function<void()> run;
+	run = [&]() {
+		LOG_TRACE("StreamRunner");
+		const bool is_consumer = std::this_thread::get_id() == consumer_thread;
+		std::unique_lock lock(mutex);
+		while (can_take()) {
+			const size_t query = next_query++;
+			lock.unlock();
+
+			std::vector<Document> documents;
+			std::exception_ptr error;
+			try {
+				documents = search_server.FindTopDocuments(queries[query]);
+			}
+			catch (...) {
+				error = std::current_exception();
 			}
-		);
+
+			lock.lock();
+			const size_t slot = query % slot_count;
+			results[slot] = std::move(documents);
+			errors[slot] = error;
+			is_ready[slot] = true;
+			if (query == next_result) {
+				result_ready.notify_one();
+			}
+			if (is_consumer) {
+				break;
+			}
+		}
+		// потребитель вернётся к своему ожиданию, а обработчик продолжит работу задачей пула
+		if (is_consumer && can_take()) {
+			pool.Submit(run);
+			return;
+		}
+		--runner_count;
+		// потребитель ждёт либо результата, либо завершения обработчиков
+		result_ready.notify_one();
+	};
+
+	// запускаем обработчики, пока есть что брать и не заняты все потоки пула (под mutex)
+	const auto start_runners = [&]() {
+		for (size_t queued = next_query; runner_count < pool.GetWorkerCount() && queued < queries.size()
+			&& queued < next_result + slot_count; ++queued) {
+			++runner_count;
+			pool.Submit(run);
+		}
+	};
+
+	// ждём, пока pred() не станет истинным, выполняя задачи пула (lock захвачен)
+	const auto wait = [&](std::unique_lock<std::mutex>& lock, const auto& pred) {
+		while (!pred()) {
+			lock.unlock();
+			const bool has_run = pool.RunPendingTask();
+			lock.lock();
+			// задач нет - все запущенные обработчики уже выполняются и разбудят потребителя
+			if (!has_run && !pred()) {
+				result_ready.wait(lock);
+			}
+		}
+	};
+
+	std::unique_lock lock(mutex);
+	try {
+		start_runners();
+		for (size_t query = 0; query < queries.size(); ++query) {
+			const size_t slot = query % slot_count;
+			wait(lock, [&]() { return is_ready[slot] != 0; });
+			std::vector<Document> documents = std::move(results[slot]);
+			const std::exception_ptr error = errors[slot];
+			errors[slot] = nullptr;
+			is_ready[slot] = false;
+			++next_result;
+			start_runners();
+			lock.unlock();
+
+			if (error) {
+				std::rethrow_exception(error);
+			}
+			consumer(query, documents);
+			lock.lock();
+		}
+	}
+	catch (...) {
+		if (!lock.owns_lock()) {
+			lock.lock();
+		}
+		is_stopping = true;
+		wait(lock, [&]() { return runner_count == 0; });
+		throw;
 	}
+	// обработчики ссылаются на локальные переменные - дожидаемся их завершения
+	wait(lock, [&]() { return runner_count == 0; });
+}
 
-	return processed_joined_queries;
-}
\ No newline at end of file
+void ProcessQueriesJoinedStreamed(
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	const std::function<void(const Document&)>& consumer, size_t window_size, ThreadPool& pool) {
+
+	ProcessQueriesStreamed(search_server, queries,
+		[&consumer](size_t, std::vector<Document>& docs) {
+			for (const Document& doc : docs) {
+				consumer(doc);
+			}
+		},
+		window_size, pool
+	);
+}
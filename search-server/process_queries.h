@@ -1,9 +1,40 @@
 #pragma once
 
+#include <functional>
+
 #include "search_server.h"
+#include "thread_pool.h"
+
+// Сколько результатов может быть посчитано, но ещё не отдано потребителю при потоковой обработке
+const size_t STREAM_WINDOW_SIZE = 1024;
 
+// Запросы обрабатываются параллельно на пуле pool
 std::vector<std::vector<Document>> ProcessQueries (
-	const SearchServer& search_server, const std::vector<std::string>& queries);
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	ThreadPool& pool = ThreadPool::GetDefault());
+
+// Те же результаты пакетом (SearchServer::FindTopDocumentsBatch): списки вхождений общих слов
+// распаковываются один раз на все запросы. Выгоден, начиная с сотни запросов, и тем больше, чем чаще
+// слова повторяются; на десятке запросов распаковка не окупается - тогда быстрее ProcessQueries
+std::vector<std::vector<Document>> ProcessQueriesBatched (
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	ThreadPool& pool = ThreadPool::GetDefault());
 
 std::vector<Document> ProcessQueriesJoined (
-	const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	ThreadPool& pool = ThreadPool::GetDefault());
+
+// Потоковая обработка: запросы считают потоки пула, а consumer(номер запроса, документы) получает
+// результаты по порядку запросов в вызывающем потоке. Пул уходит вперёд не больше чем на window_size
+// запросов, поэтому в памяти одновременно не больше window_size результатов. Ошибка запроса выбрасывается,
+// когда до него дойдёт очередь (результаты предыдущих уже отданы); ошибка consumer останавливает обработку
+void ProcessQueriesStreamed (
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	const std::function<void(size_t, std::vector<Document>&)>& consumer, size_t window_size = STREAM_WINDOW_SIZE,
+	ThreadPool& pool = ThreadPool::GetDefault());
+
+// То же, что ProcessQueriesJoined, но документы по одному отдаются в consumer
+void ProcessQueriesJoinedStreamed (
+	const SearchServer& search_server, const std::vector<std::string>& queries,
+	const std::function<void(const Document&)>& consumer, size_t window_size = STREAM_WINDOW_SIZE,
+	ThreadPool& pool = ThreadPool::GetDefault());
@@ -1,45 +1,56 @@
-#include "search_server.h"
+#include <algorithm>
+#include <unordered_map>
+
+#include "remove_duplicates.h"
 
 
 using namespace std::string_literals;
 
 
-void RemoveDuplicates(SearchServer& search_server) {
-    // id 
-    std::vector<int> remove_ids;
-    //   
-    std::set<std::set<std::string>> uniques;
-
-    //    
-    for (const int id : search_server) {
-        
-        //   ,  tf
-        std::set<std::string> unique;
-         /*
-         ,    std::transform   range based for?
-        
-        std::transform(search_server.GetWordFrequencies(id).begin(), search_server.GetWordFrequencies(id).end(),
-                       unique.begin(), [](const auto& [word, tf]){ return word; });
-        
-        ????
-        */
-
-        for (const auto& [word, tf] : search_server.GetWordFrequencies(id)) {
-            unique.insert(word);
-        }
+namespace {
+
+//Одинаковы ли наборы слов документов (частоты не сравниваем)
+bool HasSameWords(const SearchServer& search_server, int lhs_id, int rhs_id) {
+    const std::map<std::string_view, double> lhs_words = search_server.GetWordFrequencies(lhs_id);
+    const std::map<std::string_view, double> rhs_words = search_server.GetWordFrequencies(rhs_id);
+    return std::equal(lhs_words.begin(), lhs_words.end(), rhs_words.begin(), rhs_words.end(),
+        [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; });
+}
 
-        //     , , -   
-        if (uniques.count(unique)) {
+}
+
+template <typename ExecutionPolicy>
+void RemoveDuplicates(const ExecutionPolicy& policy, SearchServer& search_server) {
+    LOG_TRACE("RemoveDuplicates");
+    //Эти id удаляем
+    std::vector<int> remove_ids;
+    //Отпечаток - id оставленных документов с ним (больше одного, только если совпали отпечатки разных наборов)
+    std::unordered_map<Fingerprint, std::vector<int>, FingerprintHasher> uniques;
+
+    //Документы идут по возрастанию id, поэтому из одинаковых первым встречается документ с наименьшим id
+    for (const auto& [id, fingerprint] : search_server.GetFingerprints(policy)) {
+        std::vector<int>& kept_ids = uniques[fingerprint];
+        //Если такой набор слов уже есть, значит, это дубль
+        const bool is_duplicate = std::any_of(kept_ids.begin(), kept_ids.end(),
+            [&search_server, id = id](int kept_id) { return HasSameWords(search_server, id, kept_id); });
+        if (is_duplicate) {
             remove_ids.push_back(id);
-        //    , ,   
+        //Такого набора слов ещё нет, значит, он действительно уникален
         } else {
-            uniques.insert(unique);
+            kept_ids.push_back(id);
         }
     }
 
-    for (const int& remove_id : remove_ids) {
+    for (const int remove_id : remove_ids) {
         std::cout << "Found duplicate document id "s << remove_id << std::endl;
-        search_server.RemoveDocument(remove_id);
     }
+    search_server.RemoveDocuments(remove_ids);
+}
 
-}
\ No newline at end of file
+template void RemoveDuplicates(const std::execution::sequenced_policy&, SearchServer&);
+template void RemoveDuplicates(const std::execution::parallel_policy&, SearchServer&);
+template void RemoveDuplicates(const PoolPolicy&, SearchServer&);
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveDuplicates(std::execution::seq, search_server);
+}
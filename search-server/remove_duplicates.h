@@ -3,4 +3,10 @@
 #include "search_server.h"
 
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+//Удаляем документы с одинаковыми наборами слов: из каждой группы остаётся документ с наименьшим id.
+//Документы группируются по отпечаткам наборов слов (SearchServer::GetFingerprints), совпавшие отпечатки
+//сверяются по самим словам. С параллельной политикой отпечатки считаются параллельно
+//(определено для seq, par и PoolPolicy)
+template <typename ExecutionPolicy>
+void RemoveDuplicates(const ExecutionPolicy& policy, SearchServer& search_server);
+void RemoveDuplicates(SearchServer& search_server);
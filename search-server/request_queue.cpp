@@ -5,7 +5,7 @@ RequestQueue::RequestQueue(const SearchServer& search_server) : search_server_(s
 {}
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+    return AddFindRequest(raw_query, [status](int, DocumentStatus document_status, int) {
         return document_status == status; });
 }
 
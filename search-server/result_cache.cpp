@@ -0,0 +1,89 @@
+#include <functional>
+#include <utility>
+
+#include "result_cache.h"
+
+
+bool ResultCache::Key::operator==(const Key& other) const {
+    return query == other.query && filter == other.filter && max_result_count == other.max_result_count
+        && is_parallel == other.is_parallel;
+}
+
+size_t ResultCache::KeyHasher::operator()(const Key& key) const {
+    size_t hash = std::hash<std::string>{}(key.query);
+    hash = hash * 31 + std::hash<Filter>{}(key.filter);
+    hash = hash * 31 + key.max_result_count;
+    return hash * 2 + (key.is_parallel ? 1 : 0);
+}
+
+ResultCache::ResultCache(size_t capacity)
+    : capacity_(capacity) {
+}
+
+std::optional<std::vector<Document>> ResultCache::Find(const Key& key, uint64_t generation) {
+    std::lock_guard guard(mutex_);
+    const auto it = key_to_entry_.find(key);
+    if (it == key_to_entry_.end()) {
+        ++miss_count_;
+        return std::nullopt;
+    }
+    if (it->second->generation != generation) {
+        //Результат более нового поколения не трогаем: его ещё используют читатели новой версии
+        if (it->second->generation < generation) {
+            entries_.erase(it->second);
+            key_to_entry_.erase(it);
+        }
+        ++miss_count_;
+        return std::nullopt;
+    }
+    //Использованный результат переезжает в начало очереди
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++hit_count_;
+    return it->second->documents;
+}
+
+void ResultCache::Insert(Key key, uint64_t generation, std::vector<Document> documents) {
+    if (capacity_ == 0) {
+        return;
+    }
+    std::lock_guard guard(mutex_);
+    //Результат по ключу мог положить другой поток или другая версия индекса - заменяем его,
+    //если он не новее нашего
+    const auto it = key_to_entry_.find(key);
+    if (it != key_to_entry_.end()) {
+        if (it->second->generation > generation) {
+            return;
+        }
+        it->second->generation = generation;
+        it->second->documents = std::move(documents);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+    if (entries_.size() == capacity_) {
+        key_to_entry_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+    entries_.push_front({ key, generation, std::move(documents) });
+    key_to_entry_.emplace(std::move(key), entries_.begin());
+}
+
+size_t ResultCache::GetHitCount() const {
+    std::lock_guard guard(mutex_);
+    return hit_count_;
+}
+
+size_t ResultCache::GetMissCount() const {
+    std::lock_guard guard(mutex_);
+    return miss_count_;
+}
+
+size_t ResultCache::GetSize() const {
+    std::lock_guard guard(mutex_);
+    return entries_.size();
+}
+
+void ResultCache::Clear() {
+    std::lock_guard guard(mutex_);
+    entries_.clear();
+    key_to_entry_.clear();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "document.h"
+
+
+//Кэш результатов поиска: не больше capacity последних запросов, вытесняется самый давно использованный (LRU).
+//Результат запоминается вместе с поколением индекса, на котором он найден, и годится только для того же
+//поколения; устаревший результат удаляется при первом обращении с более новым поколением. Поколения растут,
+//поэтому читатели старой версии индекса (ConcurrentSearchServer) не вытесняют и не подменяют результаты
+//новой, а только промахиваются. Кэш можно звать из нескольких потоков
+class ResultCache {
+public:
+    //Отбор документов: по статусу или предикатом без состояния (его поведение определяется типом)
+    using Filter = std::variant<DocumentStatus, std::type_index>;
+
+    struct Key {
+        //Канонический запрос: различные плюс-слова по возрастанию, затем минус-слова с '-'
+        std::string query;
+        Filter filter;
+        size_t max_result_count;
+        //Порядок документов с равной релевантностью зависит от политики
+        bool is_parallel;
+
+        bool operator==(const Key& other) const;
+    };
+
+    explicit ResultCache(size_t capacity);
+
+    //Результат, найденный по ключу на поколении generation, или nullopt (промах)
+    std::optional<std::vector<Document>> Find(const Key& key, uint64_t generation);
+
+    //Запоминаем результат (если по ключу нет результата более нового поколения);
+    //если кэш полон, вытесняем самый давно использованный
+    void Insert(Key key, uint64_t generation, std::vector<Document> documents);
+
+    //Сколько обращений нашли результат и сколько нет
+    size_t GetHitCount() const;
+    size_t GetMissCount() const;
+
+    //Сколько результатов лежит в кэше
+    size_t GetSize() const;
+
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    //Удаляем все результаты (счётчики не сбрасываются)
+    void Clear();
+
+private:
+    struct KeyHasher {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    //От недавно использованного к давно использованному
+    std::list<Entry> entries_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> key_to_entry_;
+    size_t hit_count_ = 0;
+    size_t miss_count_ = 0;
+};
@@ -0,0 +1,23 @@
+#include <algorithm>
+
+#include "score_accumulator.h"
+
+
+ScoreAccumulator& ScoreAccumulator::ForCurrentThread() {
+    thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+void ScoreAccumulator::Reset(size_t document_count) {
+    if (scores_.size() < document_count) {
+        scores_.resize(document_count);
+        epochs_.resize(document_count, 0);
+    }
+    touched_.clear();
+    ++epoch_;
+    //Счётчик эпох переполнился - один раз чистим метки целиком
+    if (epoch_ == 0) {
+        std::fill(epochs_.begin(), epochs_.end(), 0);
+        epoch_ = 1;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+//Накопитель релевантности, адресуемый внутренним индексом документа.
+//Ячейка считается занятой, только если её метка совпадает с текущей эпохой,
+//поэтому сброс перед новым запросом стоит O(1), а обход - O(задетых документов)
+class ScoreAccumulator {
+public:
+    //Накопитель текущего потока: память переиспользуется между запросами
+    static ScoreAccumulator& ForCurrentThread();
+
+    //Готовим накопитель к запросу по document_count документам
+    void Reset(size_t document_count);
+
+    //Прибавляем релевантность документу
+    void Add(uint32_t document_index, double score) {
+        if (epochs_[document_index] != epoch_) {
+            epochs_[document_index] = epoch_;
+            scores_[document_index] = score;
+            touched_.push_back(document_index);
+        }
+        else {
+            scores_[document_index] += score;
+        }
+    }
+
+    double GetScore(uint32_t document_index) const {
+        return scores_[document_index];
+    }
+
+    //Документы в порядке первого попадания
+    const std::vector<uint32_t>& GetTouched() const {
+        return touched_;
+    }
+
+private:
+    std::vector<double> scores_;
+    std::vector<uint32_t> epochs_;
+    //Эпоха 0 означает "ячейка свободна", поэтому счёт эпох начинается с 1
+    uint32_t epoch_ = 0;
+    std::vector<uint32_t> touched_;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+
+//Срок поиска. Поиск время от времени спрашивает IsReached() и, когда срок наступил, прекращает обход:
+//возвращаются лучшие из уже просмотренных документов. После поиска IsReached() говорит,
+//полный ли результат. Части параллельного поиска спрашивают один и тот же срок
+class SearchDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit SearchDeadline(Clock::time_point deadline)
+        : deadline_(deadline) {
+    }
+
+    //Наступил ли срок; после первого true часы больше не проверяются
+    bool IsReached() {
+        if (!is_reached_.load(std::memory_order_relaxed) && Clock::now() >= deadline_) {
+            is_reached_.store(true, std::memory_order_relaxed);
+        }
+        return is_reached_.load(std::memory_order_relaxed);
+    }
+
+    //Прерывался ли поиск (часы не проверяются)
+    bool WasReached() const {
+        return is_reached_.load(std::memory_order_relaxed);
+    }
+
+    Clock::time_point GetTimePoint() const {
+        return deadline_;
+    }
+
+private:
+    Clock::time_point deadline_;
+    std::atomic<bool> is_reached_{ false };
+};
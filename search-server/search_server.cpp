@@ -1,6 +1,10 @@
+#include <atomic>
 #include <cmath>
+#include <exception>
+#include <fstream>
 #include <numeric>
 #include <iterator>
+#include <unordered_map>
 
 #include "search_server.h"
 
@@ -10,103 +14,470 @@ SearchServer::SearchServer(const std::string& stop_words_text)
 SearchServer::SearchServer(std::string_view stop_words_view)
     : SearchServer(SplitIntoWords(stop_words_view)) { }
 
-//     ,   (.  private),
-//  id     
+// Добавляем документ и выбрасываем исключение, если документ невалидный(см.ниже в private),
+// его id отрицательный или повторяется в базе
 void SearchServer::AddDocument(int id_document, std::string_view document, DocumentStatus status,
     const std::vector<int>& ratings) {
-    //         ID
-    if (id_document < 0 || documents_.count(id_document) > 0) {
+    //Теперь при добавлении документа явно проверяем только коректность его ID
+    if (id_document < 0 || id_to_index_.Find(id_document) != DocumentIdMap::NO_INDEX) {
         throw std::invalid_argument("Something wrong with ID!"s);
     }
-    //       SplitIntoWordsNoStop  
+    //Теперь проверка валидности каждого слова добавлена в SplitIntoWordsNoStop  
     const std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-    //    TF    
-    const double tf = 1.0 / static_cast<double>(words.size());
+    generation_ = NextGeneration();
+    //Документ получает следующий свободный внутренний индекс - в конце открытого сегмента
+    IndexSegment& segment = GetOpenSegment();
+    const uint32_t document_index = segment.GetEndIndex();
+    segment.AddDocument(id_document, words, status, ComputeAverageRating(ratings));
+    id_to_index_.Insert(id_document, document_index);
+    SealFullSegment();
+}
+
+// Пакет проходит те же шаги, что и AddDocument, но тексты разбираются параллельно, а весь пакет
+// добавляется в открытый сегмент одним вызовом (см. IndexSegment::AddDocuments)
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentBatch(const ExecutionPolicy& policy, std::vector<PendingDocument>& batch) {
+    LOG_TRACE("AddDocumentBatch");
+    //Разбираем документы: различные слова с TF
+    {
+        LOG_TRACE("ParseDocuments");
+        ForEach(
+            policy,
+            batch.begin(), batch.end(),
+            [this](PendingDocument& pending) {
+                std::vector<std::string_view> words;
+                try {
+                    words = SplitIntoWordsNoStop(pending.text);
+                }
+                catch (const std::invalid_argument&) {
+                    pending.has_valid_words = false;
+                    return;
+                }
+                const double tf = 1.0 / static_cast<double>(words.size());
+                std::sort(words.begin(), words.end());
+                for (std::string_view word : words) {
+                    if (pending.words.empty() || pending.words.back().word != word) {
+                        pending.words.push_back({ word, TermDictionary::NO_TERM, 0.0, TermFrequencyTable::NO_CODE });
+                    }
+                    pending.words.back().tf += tf;
+                }
+            }
+        );
+    }
+
+    //Проверяем документы по порядку; добавляются только документы до первого ошибочного, как при AddDocument по очереди
+    generation_ = NextGeneration();
+    IndexSegment& segment = GetOpenSegment();
+    const uint32_t first_index = segment.GetEndIndex();
+    std::string error;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const PendingDocument& pending = batch[i];
+        if (pending.id < 0 || id_to_index_.Find(pending.id) != DocumentIdMap::NO_INDEX) {
+            error = "Something wrong with ID!"s;
+        }
+        else if (!pending.has_valid_words) {
+            error = "Invalid word(s) in the adding doccument!"s;
+        }
+        if (!error.empty()) {
+            batch.resize(i);
+            break;
+        }
+        //Регистрируем id сразу - так ловятся и повторы внутри пакета
+        id_to_index_.Insert(pending.id, first_index + static_cast<uint32_t>(i));
+    }
+
+    //Пакет целиком попадает в один сегмент, даже если тот станет больше SEGMENT_SIZE
+    if (!batch.empty()) {
+        segment.AddDocuments(policy, batch);
+        SealFullSegment();
+    }
 
-    for (std::string_view word : words) {
-        //std::string word{word_view.data(), word_view.size()};
-        auto insert_word = all_words_.insert(std::string(word));
-        word_to_document_freqs_[*insert_word.first][id_document] += tf;
-        document_to_word_freqs_[id_document][*insert_word.first] += tf;
+    if (!error.empty()) {
+        throw std::invalid_argument(error);
     }
-    documents_.emplace(id_document, DocumentData{ ComputeAverageRating(ratings), status });
-    ids_.insert(id_document);
 }
 
-//  - ( )
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int id_document, DocumentStatus document_status, int rating)
-        { return document_status == status; });
+template void SearchServer::AddDocumentBatch(const std::execution::sequenced_policy&, std::vector<PendingDocument>&);
+template void SearchServer::AddDocumentBatch(const std::execution::parallel_policy&, std::vector<PendingDocument>&);
+template void SearchServer::AddDocumentBatch(const PoolPolicy&, std::vector<PendingDocument>&);
+
+// Выбираем ТОП-документы (по статусу)
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count);
+}
+
+// Выбираем ТОП-документы (по статусу, не позже срока)
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t max_result_count,
+    SearchDeadline& deadline) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, max_result_count, deadline);
 }
 
-//  - (     )
+// Выбираем ТОП-документы (если хочется вызвать с одним аргументом)
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
-    //     
+    // Тогда будем показывать только АКТУАЛЬНЫЕ
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-//     
+namespace {
+
+//Необязательные слова запроса пакета (как в MaxScore): слова с наименьшими верхними границами вклада в диапазоне,
+//пока сумма их границ ниже порога - документ только из их списков в набор лучших не попадёт.
+//Результат - по позициям слов запроса
+std::vector<char> FindOptionalTerms(const std::vector<size_t>& query_terms, const std::vector<double>& idfs,
+    const std::vector<double>& term_max_tfs, double threshold) {
+    std::vector<char> is_optional(query_terms.size(), false);
+    if (!(threshold > 0.0)) {
+        return is_optional;
+    }
+    const auto get_upper_bound = [&](size_t position) {
+        return term_max_tfs[query_terms[position]] * idfs[query_terms[position]];
+    };
+    std::vector<size_t> positions(query_terms.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    std::sort(positions.begin(), positions.end(),
+        [&get_upper_bound](size_t lhs, size_t rhs) { return get_upper_bound(lhs) < get_upper_bound(rhs); });
+    double bound_sum = 0.0;
+    for (const size_t position : positions) {
+        bound_sum += get_upper_bound(position);
+        if (bound_sum >= threshold) {
+            break;
+        }
+        is_optional[position] = true;
+    }
+    return is_optional;
+}
+
+//Первое вхождение не раньше position с индексом документа не меньше document_index: прыжками удваивающейся
+//длины, затем двоичным поиском (как SearchServer::ExclusionCursor)
+size_t SkipPostings(const std::vector<std::pair<uint32_t, double>>& postings, size_t position, uint32_t document_index) {
+    if (position == postings.size() || postings[position].first >= document_index) {
+        return position;
+    }
+    size_t step = 1;
+    while (postings.size() - position > step && postings[position + step].first < document_index) {
+        position += step;
+        step *= 2;
+    }
+    const size_t high = postings.size() - position > step ? position + step + 1 : postings.size();
+    return std::lower_bound(postings.begin() + position, postings.begin() + high, document_index,
+        [](const std::pair<uint32_t, double>& posting, uint32_t value) { return posting.first < value; })
+        - postings.begin();
+}
+
+}
+
+// Индекс обходится диапазонами по возрастанию: в диапазоне сначала распаковываются вхождения всех слов пакета,
+// затем каждый запрос считается по уже распакованным спискам своих слов. Запрос предлагает документы в свой
+// набор лучших по возрастанию индекса и складывает релевантность в порядке слов запроса - как последовательный
+// поиск, поэтому и результаты (включая порядок равных) совпадают.
+// Когда набор запроса заполнен, его слова делятся по порогу, как в MaxScore: вхождения необязательных слов
+// не складываются, а документ ищется в их списках, только если с их границами он может дотянуть до порога
+template <typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const ExecutionPolicy& policy,
+    const std::vector<std::string_view>& raw_queries, DocumentStatus status, size_t max_result_count) const {
+    LOG_TRACE("FindTopDocumentsBatch");
+    std::vector<size_t> query_indices(raw_queries.size());
+    std::iota(query_indices.begin(), query_indices.end(), 0);
+    std::vector<Query> queries(raw_queries.size());
+    std::vector<std::exception_ptr> errors(raw_queries.size());
+    ForEach(
+        policy,
+        query_indices.begin(), query_indices.end(),
+        [&](size_t query) {
+            try {
+                queries[query] = ParseQuerySeq(raw_queries[query]);
+            }
+            catch (...) {
+                errors[query] = std::current_exception();
+            }
+        }
+    );
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    //При K = 0 отбирать нечего (как в FindQueryTopDocuments)
+    if (max_result_count == 0) {
+        return std::vector<std::vector<Document>>(queries.size());
+    }
+
+    //Считаем только первый из одинаковых запросов и только если его нет в кэше
+    std::vector<std::vector<Document>> results(queries.size());
+    std::vector<size_t> first_same(queries.size());
+    std::vector<std::optional<ResultCache::Key>> keys(queries.size());
+    std::vector<size_t> computed;
+    std::unordered_map<std::string, size_t> key_to_query;
+    for (size_t query = 0; query < queries.size(); ++query) {
+        std::string query_key = GetQueryKey(queries[query]);
+        const auto [it, is_new] = key_to_query.emplace(query_key, query);
+        first_same[query] = it->second;
+        if (!is_new) {
+            continue;
+        }
+        if (result_cache_ != nullptr) {
+            keys[query] = ResultCache::Key{ std::move(query_key), ResultCache::Filter(status), max_result_count, false };
+            if (auto documents = result_cache_->Find(*keys[query], generation_)) {
+                results[query] = std::move(*documents);
+                continue;
+            }
+        }
+        computed.push_back(query);
+    }
+
+    //Различные слова пакета; у запроса - номера его плюс- и минус-слов в этом списке (по порядку слов запроса)
+    std::vector<std::string_view> terms;
+    for (const size_t query : computed) {
+        terms.insert(terms.end(), queries[query].plus_words.begin(), queries[query].plus_words.end());
+        terms.insert(terms.end(), queries[query].minus_words.begin(), queries[query].minus_words.end());
+    }
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    const auto get_term_indices = [&terms](const std::vector<std::string_view>& words) {
+        std::vector<size_t> term_indices;
+        term_indices.reserve(words.size());
+        for (std::string_view word : words) {
+            term_indices.push_back(static_cast<size_t>(std::lower_bound(terms.begin(), terms.end(), word) - terms.begin()));
+        }
+        return term_indices;
+    };
+    std::vector<std::vector<size_t>> plus_terms(queries.size());
+    std::vector<std::vector<size_t>> minus_terms(queries.size());
+    for (const size_t query : computed) {
+        plus_terms[query] = get_term_indices(queries[query].plus_words);
+        minus_terms[query] = get_term_indices(queries[query].minus_words);
+    }
+    //IDF слова не зависит от запроса - считаем один раз на пакет
+    const std::vector<double> idfs = CalculateIDFs(Query{ terms, {} });
+
+    std::vector<TopDocuments> top_documents(queries.size(), TopDocuments(max_result_count));
+    //Распакованные вхождения слова в текущем диапазоне: <индекс документа, TF>. Статус у всех запросов пакета
+    //один, поэтому удалённые документы и документы с другим статусом отсеиваются сразу при распаковке.
+    //Минус-слову нужен весь список, но только индексы документов
+    std::vector<std::vector<std::pair<uint32_t, double>>> term_postings(terms.size());
+    std::vector<std::vector<uint32_t>> term_documents(terms.size());
+    //Наибольший TF слова среди распакованных вхождений диапазона: вместе с IDF - верхняя граница вклада слова
+    std::vector<double> term_max_tfs(terms.size());
+    std::vector<char> is_plus_term(terms.size(), false);
+    std::vector<char> is_minus_term(terms.size(), false);
+    for (const size_t query : computed) {
+        for (const size_t term : plus_terms[query]) {
+            is_plus_term[term] = true;
+        }
+        for (const size_t term : minus_terms[query]) {
+            is_minus_term[term] = true;
+        }
+    }
+    std::vector<size_t> term_indices(terms.size());
+    std::iota(term_indices.begin(), term_indices.end(), 0);
+
+    for (const auto& segment : segments_) {
+        const TermFrequencyTable& term_frequencies = segment->GetTermFrequencies();
+        for (uint32_t first = segment->GetFirstIndex(); first < segment->GetEndIndex();) {
+            const uint32_t last = static_cast<uint32_t>(std::min<size_t>(segment->GetEndIndex(), first + BATCH_RANGE_SIZE));
+            ForEach(
+                policy,
+                term_indices.begin(), term_indices.end(),
+                [&](size_t term) {
+                    std::vector<std::pair<uint32_t, double>>& postings = term_postings[term];
+                    std::vector<uint32_t>& documents = term_documents[term];
+                    postings.clear();
+                    documents.clear();
+                    term_max_tfs[term] = 0.0;
+                    const PostingList* term_list = segment->FindPostings(terms[term]);
+                    if (term_list == nullptr) {
+                        return;
+                    }
+                    term_list->ForEachInRange(first, last, term_frequencies,
+                        [&](uint32_t document_index, double tf) {
+                            if (is_minus_term[term]) {
+                                documents.push_back(document_index);
+                            }
+                            if (is_plus_term[term] && !segment->IsDeleted(document_index)
+                                && segment->GetDocument(document_index).document_status == status) {
+                                postings.push_back({ document_index, tf });
+                                term_max_tfs[term] = std::max(term_max_tfs[term], tf);
+                            }
+                        }
+                    );
+                }
+            );
+
+            ForEach(
+                policy,
+                computed.begin(), computed.end(),
+                [&](size_t query) {
+                    if (std::all_of(plus_terms[query].begin(), plus_terms[query].end(),
+                        [&term_postings](size_t term) { return term_postings[term].empty(); })) {
+                        return;
+                    }
+                    //Документы с минус-словами: объединение их списков
+                    std::vector<uint32_t> excluded;
+                    for (const size_t term : minus_terms[query]) {
+                        excluded.insert(excluded.end(), term_documents[term].begin(), term_documents[term].end());
+                    }
+                    if (minus_terms[query].size() > 1) {
+                        std::sort(excluded.begin(), excluded.end());
+                        excluded.erase(std::unique(excluded.begin(), excluded.end()), excluded.end());
+                    }
+
+                    //Документ ниже порога уже заполненного набора не попадёт в него
+                    TopDocuments& query_top = top_documents[query];
+                    const double threshold = query_top.IsFull() ? query_top.GetWorst().relevance - 2 * EPSILON
+                        : -std::numeric_limits<double>::infinity();
+                    const std::vector<size_t>& query_terms = plus_terms[query];
+                    const std::vector<char> is_optional = FindOptionalTerms(query_terms, idfs, term_max_tfs, threshold);
+                    ScoreAccumulator& document_to_relevance = ScoreAccumulator::ForCurrentThread();
+                    document_to_relevance.Reset(last - first);
+
+                    if (std::find(is_optional.begin(), is_optional.end(), true) == is_optional.end()) {
+                        //<индекс документа - first, relevance>
+                        for (const size_t term : query_terms) {
+                            ExclusionCursor exclusion(excluded);
+                            for (const auto& [document_index, tf] : term_postings[term]) {
+                                if (excluded.empty() || !exclusion.IsExcluded(document_index)) {
+                                    document_to_relevance.Add(document_index - first, tf * idfs[term]);
+                                }
+                            }
+                        }
+                        //Документы ниже порога не сортируем
+                        std::vector<uint32_t> touched;
+                        for (const uint32_t offset : document_to_relevance.GetTouched()) {
+                            if (document_to_relevance.GetScore(offset) >= threshold) {
+                                touched.push_back(offset);
+                            }
+                        }
+                        std::sort(touched.begin(), touched.end());
+                        for (const uint32_t offset : touched) {
+                            const auto& document_data = segment->GetDocument(first + offset);
+                            query_top.Add({ document_data.id, document_to_relevance.GetScore(offset), document_data.rating });
+                        }
+                        return;
+                    }
+
+                    //Обязательные слова складываем в накопитель; точную релевантность (по всем словам в порядке
+                    //запроса, находя документ в списках прыжками) считаем, только если её не исключает граница
+                    //необязательных слов
+                    double optional_bound_sum = 0.0;
+                    for (size_t position = 0; position < query_terms.size(); ++position) {
+                        const size_t term = query_terms[position];
+                        if (is_optional[position]) {
+                            optional_bound_sum += term_max_tfs[term] * idfs[term];
+                            continue;
+                        }
+                        ExclusionCursor exclusion(excluded);
+                        for (const auto& [document_index, tf] : term_postings[term]) {
+                            if (excluded.empty() || !exclusion.IsExcluded(document_index)) {
+                                document_to_relevance.Add(document_index - first, tf * idfs[term]);
+                            }
+                        }
+                    }
+                    std::vector<uint32_t> candidates;
+                    for (const uint32_t offset : document_to_relevance.GetTouched()) {
+                        if (document_to_relevance.GetScore(offset) + optional_bound_sum >= threshold) {
+                            candidates.push_back(offset);
+                        }
+                    }
+                    std::sort(candidates.begin(), candidates.end());
+                    std::vector<size_t> cursors(query_terms.size(), 0);
+                    for (const uint32_t offset : candidates) {
+                        const uint32_t document_index = first + offset;
+                        double relevance = 0.0;
+                        for (size_t position = 0; position < query_terms.size(); ++position) {
+                            const size_t term = query_terms[position];
+                            const auto& postings = term_postings[term];
+                            cursors[position] = SkipPostings(postings, cursors[position], document_index);
+                            if (cursors[position] < postings.size() && postings[cursors[position]].first == document_index) {
+                                relevance += postings[cursors[position]].second * idfs[term];
+                            }
+                        }
+                        if (relevance >= threshold) {
+                            const auto& document_data = segment->GetDocument(document_index);
+                            query_top.Add({ document_data.id, relevance, document_data.rating });
+                        }
+                    }
+                }
+            );
+            first = last;
+        }
+    }
+
+    for (const size_t query : computed) {
+        results[query] = top_documents[query].Extract();
+        if (keys[query]) {
+            result_cache_->Insert(std::move(*keys[query]), generation_, results[query]);
+        }
+    }
+    for (size_t query = 0; query < queries.size(); ++query) {
+        if (first_same[query] != query) {
+            results[query] = results[first_same[query]];
+        }
+    }
+    return results;
+}
+
+template std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::sequenced_policy&,
+    const std::vector<std::string_view>&, DocumentStatus, size_t) const;
+template std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::execution::parallel_policy&,
+    const std::vector<std::string_view>&, DocumentStatus, size_t) const;
+template std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const PoolPolicy&,
+    const std::vector<std::string_view>&, DocumentStatus, size_t) const;
+
+// Узнаём сколько у нас документов
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return id_to_index_.GetSize();
 }
 
 // 
 SearchServer::id_const_iterator SearchServer::begin() {
-    return ids_.begin();
+    return id_to_index_.begin();
 }
 SearchServer::id_const_iterator SearchServer::end() {
-    return ids_.end();
+    return id_to_index_.end();
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double> empty_map{};
-    if (document_to_word_freqs_.empty()) {
-        return empty_map;
-    }
-    else {
-        return document_to_word_freqs_.at(document_id);
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    const uint32_t document_index = id_to_index_.Find(document_id);
+    if (document_index == DocumentIdMap::NO_INDEX) {
+        return {};
     }
+    return segments_[FindSegment(document_index)]->GetWordFrequencies(document_index);
 }
 
-//  - " -?"
+// Проверка - "это стоп-слово?"
 bool SearchServer::IsStopWord(std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-//   -
+// Проверка на спец-символы
 bool SearchServer::IsValidWord(std::string_view word) {
-    //    ,    -
+    // Валидным считаем то слово, которое не содержит спец-символы
     return std::none_of(word.begin(), word.end(),
         [](char c) { return c >= '\0' && c < ' '; });
 }
 
-//  ,     (' - ')
+// Выбрасываем исключение, если находим одинокий минус (' - ')
 void SearchServer::LonelyMinusTerminator(std::string_view word) const {
     if (word.size() == 1 && word[0] == '-') {
         throw std::invalid_argument("This word contains only \'-\' and nothing else"s);
     }
 }
 
-//        -
+//Формируем вектор из строки с пробелами и вычёркиваем стоп-слова. Стоп-слова проверены в конструкторе,
+//поэтому управляющий символ в любом слове текста означает недопустимое слово
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-    std::vector<std::string_view> words = SplitIntoWords(text);
-    std::vector<std::string_view> words_no_stop;
-    words_no_stop.reserve(words.size());
-
-    std::for_each(
-        words.begin(), words.end(),
-        [this, &words_no_stop](std::string_view word) {
-            if (stop_words_.count(word) == 0) {
-                !IsValidWord(word) ? throw std::invalid_argument("Invalid word(s) in the adding doccument!"s)
-                    : words_no_stop.push_back(word);
-            }
-        }
-    );
-
-    return words_no_stop;
+    std::vector<std::string_view> words;
+    if (SplitIntoWords(text, words) != words.size()) {
+        throw std::invalid_argument("Invalid word(s) in the adding doccument!"s);
+    }
+    if (!stop_words_.empty()) {
+        words.erase(std::remove_if(words.begin(), words.end(),
+            [this](std::string_view word) { return IsStopWord(word); }), words.end());
+    }
+    return words;
 }
 
-//    
+// Вычисляем средний рейтинг документа
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -115,46 +486,29 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
         static_cast<int>(ratings.size());
 }
 
-//    
+// Парсинг слова строки запроса; спец-символы в слове уже проверил ParseQuery
 SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view word) const {
-    //  ?
-    if (!IsValidWord(word)) {
-        throw std::invalid_argument("Your word has a special character!"s);
-    }
-    //    
+    //Проверка на отсутствие одинокого минуса
     LonelyMinusTerminator(word);
 
     bool is_minus = false;
-    // -?
+    //Это минус-слово?
     if (word[0] == '-') {
-        //      ?
+        //Это слово с префиксом из двух минусов?
         if (word[1] == '-') {
-            //   !
+            //Нам такое не подходит!
             throw std::invalid_argument("Trying to set minus-minus word!"s);
         }
-        //  -!   "-" .
+        //Это просто минус-слово! Теперь уберём "-" впереди.
         is_minus = true;
         word = word.substr(1);
     }
     return { is_minus, IsStopWord(word), word };
 }
 
-//   
+// Парсинг строки запроса
 SearchServer::Query SearchServer::ParseQuerySeq(std::string_view text) const {
-
-    std::vector<std::string_view> words = SplitIntoWords(text);
-    Query query;
-
-    std::for_each(
-        words.begin(), words.end(),
-        [this, &query](auto& word) {
-            const QueryWord query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                query_word.is_minus ? query.minus_words.push_back(query_word.word)
-                    : query.plus_words.push_back(query_word.word);
-            }
-        }
-    );
+    Query query = ParseQuery(text);
 
     std::sort(query.minus_words.begin(), query.minus_words.end());
     std::sort(query.plus_words.begin(), query.plus_words.end());
@@ -165,46 +519,195 @@ SearchServer::Query SearchServer::ParseQuerySeq(std::string_view text) const {
     return query;
 }
 
+// Слова не содержат пробелов, а минус-слово не может начинаться с '-', поэтому ключ однозначен
+std::string SearchServer::GetQueryKey(const Query& query) {
+    std::string key;
+    for (std::string_view word : query.plus_words) {
+        key.append(word).push_back(' ');
+    }
+    for (std::string_view word : query.minus_words) {
+        key.append("-"s).append(word).push_back(' ');
+    }
+    return key;
+}
+
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
 
-    std::vector<std::string_view> words = SplitIntoWords(text);
+    std::vector<std::string_view> words;
+    const size_t first_invalid = SplitIntoWords(text, words);
     Query query;
 
-    std::for_each(
-        words.begin(), words.end(),
-        [this, &query](auto& word) {
-            const QueryWord query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                query_word.is_minus ? query.minus_words.push_back(query_word.word)
-                    : query.plus_words.push_back(query_word.word);
-            }
+    //Слова разбираем по порядку: ошибка в слове до недопустимого выбрасывается раньше
+    for (size_t i = 0; i < words.size(); ++i) {
+        //Это валидное слово?
+        if (i == first_invalid) {
+            throw std::invalid_argument("Your word has a special character!"s);
         }
-    );
+        const QueryWord query_word = ParseQueryWord(words[i]);
+        if (!query_word.is_stop) {
+            query_word.is_minus ? query.minus_words.push_back(query_word.word)
+                : query.plus_words.push_back(query_word.word);
+        }
+    }
 
     return query;
 }
 
-//  IDF    
-double SearchServer::CalculateIDF(std::string_view plus_word) const {
-    return std::log(static_cast<double>(GetDocumentCount()) / static_cast<double>(word_to_document_freqs_.find(plus_word)->second.size()));
+// Вычилсить IDF плюс-слов запроса: число неудалённых документов со словом складывается по всем сегментам
+std::vector<double> SearchServer::CalculateIDFs(const Query& query) const {
+    std::vector<double> idfs(query.plus_words.size(), 0.0);
+    for (size_t position = 0; position < query.plus_words.size(); ++position) {
+        size_t document_frequency = 0;
+        for (const auto& segment : segments_) {
+            document_frequency += segment->GetDocumentFrequency(query.plus_words[position]);
+        }
+        if (document_frequency > 0) {
+            idfs[position] = std::log(static_cast<double>(GetDocumentCount()) / static_cast<double>(document_frequency));
+        }
+    }
+    return idfs;
+}
+
+// Не меньше MIN_PARTITION_SIZE индексов на часть и не больше PARTITIONS_PER_THREAD частей на поток;
+// сегмент делится на части поровну и не меньше чем на одну
+std::vector<SearchServer::Partition> SearchServer::GetPartitions(size_t thread_count) const {
+    size_t slot_count = 0;
+    for (const auto& segment : segments_) {
+        slot_count += segment->GetSlotCount();
+    }
+    const size_t partition_count = std::max<size_t>(1, std::min((slot_count + MIN_PARTITION_SIZE - 1) / MIN_PARTITION_SIZE,
+        std::max<size_t>(1, thread_count) * PARTITIONS_PER_THREAD));
+    const size_t partition_size = std::max(MIN_PARTITION_SIZE, (slot_count + partition_count - 1) / partition_count);
+
+    std::vector<Partition> partitions;
+    for (const auto& segment : segments_) {
+        const size_t segment_slot_count = segment->GetSlotCount();
+        if (segment_slot_count == 0) {
+            continue;
+        }
+        const size_t segment_partition_count = (segment_slot_count + partition_size - 1) / partition_size;
+        for (size_t partition = 0; partition < segment_partition_count; ++partition) {
+            partitions.push_back({ segment.get(),
+                segment->GetFirstIndex() + static_cast<uint32_t>(partition * segment_slot_count / segment_partition_count),
+                segment->GetFirstIndex() + static_cast<uint32_t>((partition + 1) * segment_slot_count / segment_partition_count) });
+        }
+    }
+    return partitions;
+}
+
+std::vector<const PostingList*> SearchServer::FindMinusPostings(const IndexSegment& segment, const Query& query) {
+    std::vector<const PostingList*> minus_postings;
+    for (std::string_view minus_word : query.minus_words) {
+        const PostingList* postings = segment.FindPostings(minus_word);
+        if (postings != nullptr && !postings->IsEmpty()) {
+            minus_postings.push_back(postings);
+        }
+    }
+    return minus_postings;
+}
+
+// Объединяем списки минус-слов в пределах диапазона: один список уже отсортирован, несколько - сортируем
+std::vector<uint32_t> SearchServer::CollectExcludedDocuments(const std::vector<const PostingList*>& minus_postings,
+    uint32_t first, uint32_t last, const TermFrequencyTable& term_frequencies) {
+    std::vector<uint32_t> excluded;
+    for (const PostingList* postings : minus_postings) {
+        postings->ForEachInRange(first, last, term_frequencies,
+            [&excluded](uint32_t document_index, double) { excluded.push_back(document_index); });
+    }
+    if (minus_postings.size() > 1) {
+        std::sort(excluded.begin(), excluded.end());
+        excluded.erase(std::unique(excluded.begin(), excluded.end()), excluded.end());
+    }
+    return excluded;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    RemoveDocument(std::execution::seq, document_id);
+    const uint32_t document_index = id_to_index_.Find(document_id);
+    if (document_index == DocumentIdMap::NO_INDEX) {
+        return;
+    }
+    generation_ = NextGeneration();
+    //Индекс остаётся занятым: индексы других документов не сдвигаются
+    GetMutableSegment(FindSegment(document_index)).RemoveDocument(document_index);
+    id_to_index_.Erase(document_id);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    bool is_removed = false;
+    for (const int document_id : document_ids) {
+        const uint32_t document_index = id_to_index_.Find(document_id);
+        if (document_index == DocumentIdMap::NO_INDEX) {
+            continue;
+        }
+        GetMutableSegment(FindSegment(document_index)).RemoveDocument(document_index);
+        id_to_index_.Erase(document_id);
+        is_removed = true;
+    }
+    if (is_removed) {
+        generation_ = NextGeneration();
+    }
 }
 
-//   -      ,   
+// Сначала каждый сегмент хеширует свои слова, затем части индекса складывают отпечатки своих документов
+template <typename ExecutionPolicy>
+std::vector<std::pair<int, Fingerprint>> SearchServer::GetFingerprints(const ExecutionPolicy& policy) const {
+    std::vector<std::vector<Fingerprint>> term_fingerprints(segments_.size());
+    ForEach(
+        policy,
+        segments_.begin(), segments_.end(),
+        [&](const std::shared_ptr<IndexSegment>& segment) {
+            term_fingerprints[&segment - segments_.data()] = segment->GetTermFingerprints();
+        }
+    );
+
+    //Отпечатки по внутреннему индексу документа
+    std::vector<Fingerprint> index_fingerprints(segments_.empty() ? 0 : segments_.back()->GetEndIndex());
+    size_t thread_count = 1;
+    if constexpr (IS_PARALLEL_POLICY<ExecutionPolicy>) {
+        thread_count = GetThreadPool(policy).GetWorkerCount();
+    }
+    const std::vector<Partition> partitions = GetPartitions(thread_count);
+    ForEach(
+        policy,
+        partitions.begin(), partitions.end(),
+        [&](const Partition& partition) {
+            const auto& [segment, first, last] = partition;
+            const std::vector<Fingerprint>& segment_term_fingerprints = term_fingerprints[FindSegment(first)];
+            for (uint32_t document_index = first; document_index < last; ++document_index) {
+                if (!segment->IsDeleted(document_index)) {
+                    index_fingerprints[document_index] = segment->GetDocumentFingerprint(document_index, segment_term_fingerprints);
+                }
+            }
+        }
+    );
+
+    std::vector<std::pair<int, Fingerprint>> fingerprints;
+    fingerprints.reserve(id_to_index_.GetSize());
+    for (auto it = id_to_index_.begin(); it != id_to_index_.end(); ++it) {
+        fingerprints.push_back({ *it, index_fingerprints[it.GetDocumentIndex()] });
+    }
+    return fingerprints;
+}
+
+template std::vector<std::pair<int, Fingerprint>> SearchServer::GetFingerprints(const std::execution::sequenced_policy&) const;
+template std::vector<std::pair<int, Fingerprint>> SearchServer::GetFingerprints(const std::execution::parallel_policy&) const;
+template std::vector<std::pair<int, Fingerprint>> SearchServer::GetFingerprints(const PoolPolicy&) const;
+
+// Матчинг документов - возвращаем все слова из поискового запроса, присутствующие в документе
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query,
     int document_id) const {
-    //      ParseQuery (ParseQueryWord)
+    // Валидность поискового запроса проверяется внутри ParseQuery (ParseQueryWord)
     const Query query = ParseQuerySeq(raw_query);
+    const uint32_t document_index = id_to_index_.Find(document_id);
+    if (document_index == DocumentIdMap::NO_INDEX) {
+        throw std::out_of_range("There is no document with this id"s);
+    }
+    const IndexSegment& segment = *segments_[FindSegment(document_index)];
+    const DocumentStatus document_status = segment.GetDocument(document_index).document_status;
 
     for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.find(word)->second.count(document_id)) {
-            return { std::vector<std::string_view> {}, documents_.at(document_id).document_status };
+        if (segment.ContainsWord(word, document_index)) {
+            return { std::vector<std::string_view> {}, document_status };
         }
     }
 
@@ -212,15 +715,12 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     //matched_words.reserve(query.plus_words.size());
 
     for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.find(word)->second.count(document_id)) {
+        if (segment.ContainsWord(word, document_index)) {
             matched_words.push_back(word);
         }
     }
 
-    return { matched_words, documents_.at(document_id).document_status };
+    return { matched_words, document_status };
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
@@ -228,43 +728,272 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const {
+    return MatchDocument(ThreadPool::GetDefault().GetPolicy(), raw_query, document_id);
+}
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const PoolPolicy& policy, std::string_view raw_query, int document_id) const {
 
-    if (!ids_.count(document_id)) {
+    const uint32_t document_index = id_to_index_.Find(document_id);
+    if (document_index == DocumentIdMap::NO_INDEX) {
         throw std::out_of_range("There is no document with this id"s);
     }
 
     Query query = ParseQuery(raw_query);
+    const IndexSegment& segment = *segments_[FindSegment(document_index)];
+    //Слово есть в документе, если документ есть в списке вхождений слова
+    const auto contains = [&segment, document_index](std::string_view word) {
+        return segment.ContainsWord(word, document_index);
+    };
 
-    if (
-        std::any_of(
-            query.minus_words.begin(), query.minus_words.end(),
-            [&](auto& minus_word) {
-                return document_to_word_freqs_.at(document_id).count(minus_word);
-            }
-        )) {
+    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), contains)) {
         return std::tuple<std::vector<std::string_view>, DocumentStatus>{};
     }
 
+    //Слова проверяются параллельно, а собираются по порядку
+    std::vector<char> is_matched(query.plus_words.size());
+    policy.pool->ParallelFor(query.plus_words.size(),
+        [&](size_t i) { is_matched[i] = contains(query.plus_words[i]); });
     std::vector<std::string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
-    auto last = std::copy_if(
-        std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(),
-        [&](auto& plus_word) {
-            if (word_to_document_freqs_.count(plus_word)) {
-                return word_to_document_freqs_.find(plus_word)->second.count(document_id) > 0;
-            }
-            else {
-                return false;
-            }
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (is_matched[i]) {
+            matched_words.push_back(query.plus_words[i]);
         }
-    );
-
-    matched_words.erase(last, matched_words.end());
+    }
     std::sort(matched_words.begin(), matched_words.end());
     auto to_delete = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(to_delete, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).document_status };
-}
\ No newline at end of file
+    return { matched_words, segment.GetDocument(document_index).document_status };
+}
+
+// Порядок разделов снимка: стоп-слова, сегменты по возрастанию индексов, пары <id, индекс> живых документов
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Can't create snapshot "s + path);
+    }
+    SnapshotWriter writer(out);
+    writer.WriteHeader();
+
+    writer.WriteStrings({ stop_words_.begin(), stop_words_.end() });
+    writer.Write(static_cast<uint64_t>(segments_.size()));
+    for (const auto& segment : segments_) {
+        segment->Save(writer);
+    }
+
+    std::vector<int> ids;
+    std::vector<uint32_t> indices;
+    ids.reserve(id_to_index_.GetSize());
+    indices.reserve(id_to_index_.GetSize());
+    for (auto it = id_to_index_.begin(); it != id_to_index_.end(); ++it) {
+        ids.push_back(*it);
+        indices.push_back(it.GetDocumentIndex());
+    }
+    writer.Write(static_cast<uint64_t>(ids.size()));
+    writer.WriteArray(ids.data(), ids.size());
+    writer.WriteArray(indices.data(), indices.size());
+
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Can't write snapshot "s + path);
+    }
+}
+
+SearchServer SearchServer::OpenSnapshot(const std::string& path) {
+    SearchServer search_server;
+    const auto snapshot = std::make_shared<const MappedFile>(path);
+    SnapshotReader reader(snapshot->GetData(), snapshot->GetSize());
+    reader.ReadHeader();
+
+    for (std::string_view stop_word : reader.ReadStrings()) {
+        search_server.stop_words_.emplace_hint(search_server.stop_words_.end(), stop_word);
+    }
+    const uint64_t segment_count = reader.Read<uint64_t>();
+    for (size_t i = 0; i < segment_count; ++i) {
+        auto segment = std::make_shared<IndexSegment>(IndexSegment::Open(reader, snapshot));
+        //Сегменты идут по возрастанию индексов и не пересекаются (после слияний между ними бывают пропуски)
+        const uint32_t first_index = search_server.segments_.empty() ? 0 : search_server.segments_.back()->GetEndIndex();
+        if (segment->GetFirstIndex() < first_index) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        search_server.segments_.push_back(std::move(segment));
+    }
+
+    //Пары записаны по возрастанию id - дописываем их в конец таблицы
+    const uint64_t id_count = reader.Read<uint64_t>();
+    const int* ids = reader.ReadArray<int>(id_count);
+    const uint32_t* indices = reader.ReadArray<uint32_t>(id_count);
+    for (size_t i = 0; i < id_count; ++i) {
+        if (i > 0 && ids[i] <= ids[i - 1]) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        //Индекс должен указывать на документ с этим id в одном из сегментов
+        if (search_server.segments_.empty() || indices[i] < search_server.segments_.front()->GetFirstIndex()) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        const IndexSegment& segment = *search_server.segments_[search_server.FindSegment(indices[i])];
+        if (indices[i] >= segment.GetEndIndex() || segment.GetDocument(indices[i]).id != ids[i]) {
+            throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+        }
+        search_server.id_to_index_.Insert(ids[i], indices[i]);
+    }
+
+    if (!reader.IsEnd()) {
+        throw std::invalid_argument("Snapshot has unexpected trailing data"s);
+    }
+    return search_server;
+}
+
+size_t SearchServer::FindSegment(uint32_t document_index) const {
+    const auto it = std::upper_bound(segments_.begin(), segments_.end(), document_index,
+        [](uint32_t index, const auto& segment) { return index < segment->GetFirstIndex(); });
+    return static_cast<size_t>(it - segments_.begin()) - 1;
+}
+
+// Если сегментом владеет только этот сервер, его можно менять на месте. Последняя чужая ссылка могла
+// быть отпущена в другом потоке - барьер гарантирует, что все её чтения сегмента закончились до наших записей
+IndexSegment& SearchServer::GetMutableSegment(size_t position) {
+    std::shared_ptr<IndexSegment>& segment = segments_[position];
+    if (segment.use_count() > 1) {
+        segment = std::make_shared<IndexSegment>(*segment);
+    }
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *segment;
+}
+
+IndexSegment& SearchServer::GetOpenSegment() {
+    if (segments_.empty() || segments_.back()->IsSealed()) {
+        const uint32_t first_index = segments_.empty() ? 0 : segments_.back()->GetEndIndex();
+        segments_.push_back(std::make_shared<IndexSegment>(first_index));
+    }
+    return GetMutableSegment(segments_.size() - 1);
+}
+
+void SearchServer::SealFullSegment() {
+    if (segments_.back()->IsSealed() || segments_.back()->GetSlotCount() < SEGMENT_SIZE) {
+        return;
+    }
+    GetMutableSegment(segments_.size() - 1).Seal();
+    if (merge_on_seal_) {
+        MergeSegments();
+    }
+}
+
+size_t SearchServer::GetSegmentCount() const {
+    return segments_.size();
+}
+
+void SearchServer::SetMergeOnSeal(bool merge_on_seal) {
+    merge_on_seal_ = merge_on_seal;
+}
+
+void SearchServer::SetResultCache(std::shared_ptr<ResultCache> result_cache) {
+    result_cache_ = std::move(result_cache);
+}
+
+const std::shared_ptr<ResultCache>& SearchServer::GetResultCache() const {
+    return result_cache_;
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+uint64_t SearchServer::NextGeneration() {
+    static std::atomic<uint64_t> next_generation{ 0 };
+    return next_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace {
+
+// Уровень 0 - меньше SEGMENT_SIZE * MERGE_FACTOR живых документов, дальше каждый уровень в MERGE_FACTOR раз больше.
+// Сегмент, потерявший много документов, опускается на уровень ниже и сливается с меньшими соседями
+size_t GetMergeLevel(const IndexSegment& segment) {
+    size_t level = 0;
+    for (size_t level_size = SEGMENT_SIZE * MERGE_FACTOR; segment.GetDocumentCount() >= level_size; level_size *= MERGE_FACTOR) {
+        ++level;
+    }
+    return level;
+}
+
+} // namespace
+
+std::optional<SearchServer::SegmentMerge> SearchServer::FindMerge() const {
+    //Открытый сегмент ещё дополняется и в слияниях не участвует
+    const size_t sealed_count = segments_.empty() || segments_.back()->IsSealed() ? segments_.size() : segments_.size() - 1;
+    size_t run_begin = 0;
+    for (size_t position = 0; position < sealed_count; ++position) {
+        if (GetMergeLevel(*segments_[position]) != GetMergeLevel(*segments_[run_begin])) {
+            run_begin = position;
+        }
+        if (position + 1 - run_begin == MERGE_FACTOR) {
+            return SegmentMerge{ run_begin, { segments_.begin() + run_begin, segments_.begin() + position + 1 } };
+        }
+    }
+    for (size_t position = 0; position < sealed_count; ++position) {
+        const IndexSegment& segment = *segments_[position];
+        if (segment.GetTombstoneCount() > 0
+            && segment.GetTombstoneCount() >= COMPACTION_TOMBSTONE_SHARE * static_cast<double>(segment.GetSlotCount())) {
+            return SegmentMerge{ position, { segments_[position] } };
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<SearchServer::SegmentMerge> SearchServer::FindCompactions() const {
+    std::vector<SegmentMerge> compactions;
+    for (size_t position = 0; position < segments_.size(); ++position) {
+        if (segments_[position]->GetTombstoneCount() > 0) {
+            compactions.push_back({ position, { segments_[position] } });
+        }
+    }
+    return compactions;
+}
+
+std::shared_ptr<IndexSegment> SearchServer::BuildMerge(const SegmentMerge& merge) {
+    LOG_TRACE("BuildMerge");
+    return std::make_shared<IndexSegment>(IndexSegment::Merge(merge.segments));
+}
+
+// Изменённый после FindMerge сегмент был скопирован (см. GetMutableSegment) - его указатель уже другой.
+// Слитый сегмент перенумеровал свои документы подряд - переносим их новые индексы
+bool SearchServer::ApplyMerge(const SegmentMerge& merge, std::shared_ptr<IndexSegment> merged) {
+    if (merge.first + merge.segments.size() > segments_.size()
+        || !std::equal(merge.segments.begin(), merge.segments.end(), segments_.begin() + merge.first)) {
+        return false;
+    }
+    for (uint32_t document_index = merged->GetFirstIndex(); document_index < merged->GetEndIndex(); ++document_index) {
+        id_to_index_.SetIndex(merged->GetDocument(document_index).id, document_index);
+    }
+    const auto first = segments_.begin() + merge.first;
+    segments_.erase(first + 1, first + merge.segments.size());
+    *first = std::move(merged);
+    return true;
+}
+
+void SearchServer::MergeSegments() {
+    while (const std::optional<SegmentMerge> merge = FindMerge()) {
+        ApplyMerge(*merge, BuildMerge(*merge));
+    }
+}
+
+// Сжатый сегмент одного сегмента занимает те же позиции, поэтому следующие сжатия остаются верными
+size_t SearchServer::Compact() {
+    size_t reclaimed_memory = 0;
+    for (const SegmentMerge& compaction : FindCompactions()) {
+        const size_t memory_usage = compaction.segments.front()->GetMemoryUsage();
+        std::shared_ptr<IndexSegment> compacted = BuildMerge(compaction);
+        reclaimed_memory += memory_usage - std::min(memory_usage, compacted->GetMemoryUsage());
+        ApplyMerge(compaction, std::move(compacted));
+    }
+    return reclaimed_memory;
+}
+
+size_t SearchServer::GetMemoryUsage() const {
+    size_t memory_usage = 0;
+    for (const auto& segment : segments_) {
+        memory_usage += segment->GetMemoryUsage();
+    }
+    return memory_usage;
+}
@@ -5,138 +5,351 @@
 #include <vector>
 #include <utility>
 #include <map>
+#include <memory>
 #include <set>
 #include <tuple>
+#include <cstdint>
 #include <cmath>
+#include <limits>
 #include <algorithm>
 #include <stdexcept>
 #include <execution>
+#include <numeric>
+#include <thread>
 #include <type_traits>
+#include <typeinfo>
+#include <optional>
 
 
 #include "document.h"
+#include "document_id_map.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "index_segment.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "result_cache.h"
+#include "thread_pool.h"
+#include "search_deadline.h"
+#include "metrics.h"
+#include "log_duration.h"
+#include "snapshot.h"
 
 
 using namespace std::string_literals;
 
 
-// -
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-//   
-const double EPSILON = 1e-6;
-//   ConcurrentMap
-const size_t BUCKETS = 100;
+//Количество топ-документов по умолчанию
+const size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+//Минимальное число документов в части индекса при параллельном поиске
+const size_t MIN_PARTITION_SIZE = 4096;
+//Сколько частей индекса приходится на один поток (для выравнивания нагрузки)
+const size_t PARTITIONS_PER_THREAD = 4;
+//Сколько индексов документов пакет запросов обходит за один шаг. Порог запроса растёт от диапазона к диапазону,
+//поэтому в коротких диапазонах больше слов отсекается как необязательные; распаковка на шаг дешёвая
+const size_t BATCH_RANGE_SIZE = 2048;
+//Сколько индексов занимает открытый сегмент, прежде чем его запечатают
+const size_t SEGMENT_SIZE = 16384;
+//Сколько соседних сегментов одного уровня сливаются в один
+const size_t MERGE_FACTOR = 4;
+//Доля удалённых документов, при которой запечатанный сегмент переписывается без них при слиянии
+const double COMPACTION_TOMBSTONE_SHARE = 0.25;
+//Через сколько документов-кандидатов поиск со сроком проверяет часы
+const size_t DEADLINE_CHECK_INTERVAL = 1024;
 
 class SearchServer {
 
 private:
 
-    //  
+    //Храним парсированный запрос
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
     };
 
-    //   
+    //Храним парсированное слово запроса
     struct QueryWord {
         bool is_minus;
         bool is_stop;
         std::string_view word;
     };
 
-    //   
-    struct DocumentData {
-        int rating;
-        DocumentStatus document_status;
+    using PendingDocument = IndexSegment::PendingDocument;
+
+    //<id документа, внутренний (плотный) индекс документа>; копии сервера делят листы таблицы
+    DocumentIdMap id_to_index_;
+
+    std::set<std::string, std::less<>> stop_words_;
+
+    //Сегменты индекса по возрастанию внутренних индексов; последний может быть открытым.
+    //Копии сервера делят сегменты между собой, а меняется только сегмент с единственным владельцем
+    //(копирование при записи), поэтому копия сервера стоит O(число сегментов)
+    std::vector<std::shared_ptr<IndexSegment>> segments_;
+    //Сливать сегменты сразу после запечатывания очередного (иначе - только через MergeSegments)
+    bool merge_on_seal_ = true;
+
+    //Поколение индекса: новое при каждом добавлении и удалении. Значения берутся из общего для всех
+    //серверов счётчика, поэтому у копий, изменённых по-разному, поколения не совпадают
+    uint64_t generation_ = NextGeneration();
+    //Кэш результатов поиска (nullptr - не кэшируем); копии сервера делят его
+    std::shared_ptr<ResultCache> result_cache_;
+
+    //Часть индекса для параллельного поиска: диапазон индексов внутри одного сегмента
+    struct Partition {
+        const IndexSegment* segment;
+        uint32_t first;
+        uint32_t last;
     };
 
-    std::set<int> ids_;
+    //Курсор по списку вхождений плюс-слова при поиске документ-за-документом
+    struct TermCursor {
+        PostingList::Cursor postings;
+        double idf;
+        //Наибольший возможный вклад слова: max TF * IDF (по всему списку)
+        double upper_bound;
+        //Позиция слова в запросе: релевантность складываем в том же порядке, что и полный перебор
+        size_t query_position;
+    };
 
-    //<id ,   >
-    std::map<int, DocumentData> documents_;
+    //Проверка "есть ли в документе минус-слово" по заранее собранному отсортированному
+    //списку индексов. Документы проверяются по возрастанию индекса, поэтому курсор только
+    //движется вперёд (прыжками, если исключённых намного больше, чем проверяемых)
+    class ExclusionCursor {
+    public:
+        explicit ExclusionCursor(const std::vector<uint32_t>& excluded)
+            : current_(excluded.begin())
+            , end_(excluded.end()) {
+        }
 
-    std::set<std::string, std::less<>> stop_words_;
-    std::set<std::string, std::less<>> all_words_;
+        bool IsExcluded(uint32_t document_index) {
+            if (current_ != end_ && *current_ < document_index) {
+                size_t step = 1;
+                auto low = current_;
+                while (static_cast<size_t>(end_ - low) > step && *(low + step) < document_index) {
+                    low += step;
+                    step *= 2;
+                }
+                const auto high = static_cast<size_t>(end_ - low) > step ? low + step + 1 : end_;
+                current_ = std::lower_bound(low, high, document_index);
+            }
+            return current_ != end_ && *current_ == document_index;
+        }
+
+    private:
+        std::vector<uint32_t>::const_iterator current_;
+        std::vector<uint32_t>::const_iterator end_;
+    };
 
-    // 
-    //      < ()   <  id(),  TF  >>
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    //    < id()    <  (),   TF  >>
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    //Пустой сервер, который заполняет OpenSnapshot
+    SearchServer() = default;
+
+    //Позиция сегмента, в котором лежит документ с внутренним индексом document_index
+    size_t FindSegment(uint32_t document_index) const;
+    //Сегмент, который можно менять: общий с другими копиями сервера сначала копируется
+    IndexSegment& GetMutableSegment(size_t position);
+    //Открытый сегмент для новых документов (создаётся, если последний запечатан)
+    IndexSegment& GetOpenSegment();
+    //Запечатываем открытый сегмент, если он заполнен, и при необходимости сливаем сегменты
+    void SealFullSegment();
+
+    static uint64_t NextGeneration();
 
     bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
     void LonelyMinusTerminator(std::string_view word) const;
 
-    //        -
+    //Формируем вектор из строки с пробелами и вычёркиваем стоп-слова
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
-    //   
+    //Вычисляем средний рейтинг документа
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-    //   
+    //Парсинг слова строки запроса
     QueryWord ParseQueryWord(std::string_view word) const;
 
-    //  
+    //Парсинг строки запроса
     Query ParseQuery(std::string_view text) const;
     Query ParseQuerySeq(std::string_view text) const;
 
-    // IDF    
-    double CalculateIDF(std::string_view plus_word) const;
+    //Ключ запроса в кэше: плюс-слова, затем минус-слова с '-' (запрос уже канонический - см. ParseQuerySeq)
+    static std::string GetQueryKey(const Query& query);
 
-    //  ,   
-    template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Predicate predicate) const;
+    //Вычисляем IDF плюс-слов запроса по позициям; у слов без вхождений - 0 (их вклад не считается)
+    std::vector<double> CalculateIDFs(const Query& query) const;
+
+    //Непересекающиеся диапазоны индексов для параллельного обхода на thread_count потоках (потоки пула политики)
+    std::vector<Partition> GetPartitions(size_t thread_count) const;
+
+    //Списки вхождений минус-слов запроса в сегменте
+    static std::vector<const PostingList*> FindMinusPostings(const IndexSegment& segment, const Query& query);
+    //Отсортированные индексы документов из [first, last), в которых есть хотя бы одно минус-слово
+    static std::vector<uint32_t> CollectExcludedDocuments(const std::vector<const PostingList*>& minus_postings,
+        uint32_t first, uint32_t last, const TermFrequencyTable& term_frequencies);
+
+    //Добавляем пакет документов (определено для seq, par и PoolPolicy)
+    template <typename ExecutionPolicy>
+    void AddDocumentBatch(const ExecutionPolicy& policy, std::vector<PendingDocument>& batch);
+
+    //Предложить в набор лучших подходящие документы одного сегмента (до срока deadline, если он задан)
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, Predicate predicate) const;
+    void FindSegmentDocuments(const IndexSegment& segment, const Query& query, const std::vector<double>& idfs,
+        Predicate predicate, TopDocuments& top_documents, SearchDeadline* deadline, QueryProfile* profile) const;
+
+    //Найти все документы, подходящие под запрос, и предложить их в набор лучших.
+    //Если задан срок deadline, обход прекращается, когда он наступит. Время этапов и объём работы
+    //добавляются в profile, если он задан
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate) const;
+    void FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Predicate predicate, TopDocuments& top_documents,
+        SearchDeadline* deadline, QueryProfile* profile) const;
+    template <typename ExecutionPolicy, typename Predicate>
+    void FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate, TopDocuments& top_documents,
+        SearchDeadline* deadline, QueryProfile* profile) const;
+
+    //ТОП-документы по строке запроса. Если кэш подключён и отбор известен (filter), результат
+    //берётся из кэша или кладётся в него (результат, прерванный сроком deadline, не кладётся).
+    //Если включены метрики (IsQueryMetricsEnabled), профиль запроса записывается в метрики потока
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindQueryTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+        size_t max_result_count, const std::optional<ResultCache::Filter>& filter, SearchDeadline* deadline = nullptr) const;
 
 
 public:
 
-    typedef typename std::set<int>::const_iterator id_const_iterator;
+    typedef typename DocumentIdMap::const_iterator id_const_iterator;
     id_const_iterator begin();
     id_const_iterator end();
 
-    //  -  :
+    //Формируем множество стоп-слов — конструкторы:
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
     explicit SearchServer(const std::string& stop_words_text);
     explicit SearchServer(std::string_view stop_words_view);
 
-    //  
+    //Узнаём количество документов
     int GetDocumentCount() const;
 
-    //     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    //Получаем частоту слов в нужном документе (пустой словарь, если документа нет).
+    //Словарь собирается по запросу из прямого индекса, поэтому возвращается по значению
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
 
-    //   
+    //Добавляем документ в базу
     void AddDocument(int id_document, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    // -
+    //Добавляем пакет документов: элементы documents раскладываются как (id, текст, статус, рейтинги).
+    //Результат и ошибки те же, что у AddDocument по очереди: документы до первого ошибочного
+    //(повтор id, недопустимое слово) добавляются, затем выбрасывается исключение.
+    //С параллельной политикой (par или PoolPolicy) разбор текстов и построение списков вхождений идут параллельно
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents);
+    template <typename DocumentRange>
+    void AddDocuments(const DocumentRange& documents);
+
+    //Выбираем ТОП-документы; max_result_count - сколько лучших документов вернуть.
+    //Политика - seq, par (пул ThreadPool::GetDefault()) или PoolPolicy заданного пула.
+    //С подключённым кэшем кэшируются запросы по статусу и с предикатом без состояния (лямбда без захвата)
     template <typename ExecutionPolicy, typename Predicate>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename Predicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
-    // 
+    //ТОП-документы по статусу не позже срока deadline. Когда срок наступает, поиск прекращается и возвращаются
+    //лучшие из уже просмотренных документов; неполный ли результат, скажет deadline.WasReached()
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+        size_t max_result_count, SearchDeadline& deadline) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        size_t max_result_count, SearchDeadline& deadline) const;
+
+    //ТОП-документы по статусу для каждого запроса пакета - те же, что вернёт FindTopDocuments(seq, ...) по очереди.
+    //Список вхождений каждого слова распаковывается один раз на весь пакет, а его вхождения раскладываются
+    //по накопителям запросов с этим словом (кроме слов, которые в диапазоне уже не поднимут документ до порога). Одинаковые запросы считаются один раз; подключённый кэш
+    //используется так же, как при поиске по очереди. Из ошибочных запросов выбрасывается ошибка первого.
+    //С параллельной политикой слова распаковываются и запросы считаются параллельно (определено для seq, par и PoolPolicy)
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const ExecutionPolicy& policy,
+        const std::vector<std::string_view>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    //Матчинг документов
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PoolPolicy& policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 
-    // 
+    //Удаляем документ: он только помечается удалённым в своём сегменте и пропускается при поиске,
+    //а вхождения остаются в списках до сжатия. Удаление не зависит от политики
     template <class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
+    //Удаляем пакет документов (отсутствующие id пропускаются); поколение меняется один раз на пакет
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    //Отпечатки наборов слов всех документов: пары (id, отпечаток) по возрастанию id. У документов
+    //с одинаковыми наборами слов отпечатки одинаковые. Строки слов не копируются: каждое слово сегмента
+    //хешируется один раз, а отпечаток документа складывается по прямому индексу.
+    //С параллельной политикой сегменты и части индекса обходятся параллельно (определено для seq, par и PoolPolicy)
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<int, Fingerprint>> GetFingerprints(const ExecutionPolicy& policy) const;
+
+    //Переписываем сегменты с удалёнными документами: из списков уходят их вхождения, из словарей -
+    //слова, у которых не осталось вхождений. Возвращаем, сколько байт освободилось (память сегментов,
+    //общих с копиями сервера, освобождается, когда их отпустит последняя копия)
+    size_t Compact();
+    //Сколько байт кучи занимают сегменты индекса (оценка)
+    size_t GetMemoryUsage() const;
+
+    //Подключаем кэш результатов поиска (nullptr - отключаем). Копии сервера, в том числе версии
+    //ConcurrentSearchServer, делят подключённый кэш: результат каждой годится только для её поколения
+    void SetResultCache(std::shared_ptr<ResultCache> result_cache);
+    const std::shared_ptr<ResultCache>& GetResultCache() const;
+
+    //Поколение индекса: меняется при каждом добавлении и удалении документов, но не при слиянии и сжатии
+    uint64_t GetGeneration() const;
+
+    //Сохраняем индекс целиком (стоп-слова, сегменты и id документов) в файл снимка
+    void SaveSnapshot(const std::string& path) const;
+    //Открываем снимок без повторного разбора документов: файл отображается в память, слова словарей
+    //и сжатые списки вхождений сегментов читаются прямо из него. Остальное (хеш-таблицы, прямой индекс)
+    //восстанавливается копированием массивов. После открытия сервер можно дополнять как обычно.
+    //Файл нельзя перезаписывать, пока жив открытый из него сервер или его копии
+    static SearchServer OpenSnapshot(const std::string& path);
+
+    //Слияние сегментов: соседние запечатанные сегменты segments, начиная с позиции first
+    struct SegmentMerge {
+        size_t first;
+        std::vector<std::shared_ptr<const IndexSegment>> segments;
+    };
+
+    size_t GetSegmentCount() const;
+
+    //Сливать ли сегменты сразу при запечатывании. Без этого слияние запускает владелец сервера
+    //(MergeSegments или FindMerge/BuildMerge/ApplyMerge, например в фоновом потоке)
+    void SetMergeOnSeal(bool merge_on_seal);
+
+    //Ступенчатая политика: сливаются MERGE_FACTOR соседних запечатанных сегментов одного уровня.
+    //Уровень растёт с каждым умножением числа документов на MERGE_FACTOR, поэтому каждый документ
+    //переписывается O(log N) раз. Запечатанный сегмент, в котором удалено не меньше
+    //COMPACTION_TOMBSTONE_SHARE документов, переписывается отдельно. nullopt - сливать нечего
+    std::optional<SegmentMerge> FindMerge() const;
+    //Строим слитый сегмент; сервер не нужен, поэтому это можно делать без блокировки
+    static std::shared_ptr<IndexSegment> BuildMerge(const SegmentMerge& merge);
+    //Подменяем сегменты слитым, если с момента FindMerge они не менялись (иначе false и ничего не делаем)
+    bool ApplyMerge(const SegmentMerge& merge, std::shared_ptr<IndexSegment> merged);
+    //Сливаем сегменты, пока политика находит, что сливать
+    void MergeSegments();
+    //Сжатия для Compact: каждый сегмент с удалёнными документами переписывается сам по себе
+    std::vector<SegmentMerge> FindCompactions() const;
 };
 
 template <typename StringContainer>
@@ -150,144 +363,360 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 }
 
 
+template <typename ExecutionPolicy, typename DocumentRange>
+void SearchServer::AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents) {
+    std::vector<PendingDocument> batch;
+    for (const auto& [id_document, document, status, ratings] : documents) {
+        batch.push_back({ id_document, std::string_view(document), status, ComputeAverageRating(ratings), true, false, {} });
+    }
+    AddDocumentBatch(policy, batch);
+}
+
+template <typename DocumentRange>
+void SearchServer::AddDocuments(const DocumentRange& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+
+//Последовательный поиск идёт документ-за-документом по алгоритму MaxScore. Слова упорядочены
+//по верхней границе вклада; когда набор лучших заполнен, слова с малой суммарной границей
+//становятся необязательными: документ, который есть только в их списках, уже не попадёт в набор,
+//поэтому кандидатов берём лишь из обязательных списков, а необязательные проверяем прыжками.
+//Сегменты обходятся по возрастанию индексов, и порог переходит из сегмента в сегмент.
+//Результат совпадает с полным перебором
 template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate) const {
-    //    
-    std::vector<Document> matched_documents;
-    //<id, relevance> (relevance = sum(tf * idf))
-    std::map<int, double> document_to_relevance;
-
-    //   document_to_relevance  -   
-    for (std::string_view plus_word : query.plus_words) {
-        if (word_to_document_freqs_.count(plus_word)) {
-            // IDF    
-            const double idf = CalculateIDF(plus_word);
-            for (const auto& [id_document, tf] : word_to_document_freqs_.find(plus_word)->second) {
-                const auto& document_data = documents_.at(id_document);
-                if (predicate(id_document, document_data.document_status, document_data.rating)) {
-                    //       -
-                    document_to_relevance[id_document] += tf * idf;
-                }
-            }
+void SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Predicate predicate,
+    TopDocuments& top_documents, SearchDeadline* deadline, QueryProfile* profile) const {
+    const std::vector<double> idfs = CalculateIDFs(query);
+    for (const auto& segment : segments_) {
+        if (deadline != nullptr && deadline->IsReached()) {
+            return;
         }
-        else { continue; }
+        FindSegmentDocuments(*segment, query, idfs, predicate, top_documents, deadline, profile);
     }
+}
 
-    //  document_to_relevance   -
-    for (std::string_view minus_word : query.minus_words) {
-        if (word_to_document_freqs_.count(minus_word)) {
-            for (const auto& [id_document, relevance] : word_to_document_freqs_.find(minus_word)->second) {
-                document_to_relevance.erase(id_document);
-            }
+template <typename Predicate>
+void SearchServer::FindSegmentDocuments(const IndexSegment& segment, const Query& query, const std::vector<double>& idfs,
+    Predicate predicate, TopDocuments& top_documents, SearchDeadline* deadline, QueryProfile* profile) const {
+    const TermFrequencyTable& term_frequencies = segment.GetTermFrequencies();
+    std::vector<TermCursor> cursors;
+    for (size_t position = 0; position < query.plus_words.size(); ++position) {
+        const PostingList* postings = segment.FindPostings(query.plus_words[position]);
+        if (postings == nullptr || postings->IsEmpty()) {
+            continue;
         }
-        else { continue; }
+        const double idf = idfs[position];
+        cursors.push_back({ PostingList::Cursor(*postings, term_frequencies), idf, postings->GetMaxTf() * idf, position });
     }
-
-    //    Document
-    for (const auto& [id_document, relevance] : document_to_relevance) {
-        matched_documents.push_back({ id_document, relevance, documents_.at(id_document).rating });
+    std::sort(cursors.begin(), cursors.end(),
+        [](const TermCursor& lhs, const TermCursor& rhs) { return lhs.upper_bound < rhs.upper_bound; });
+    //bound_sums[i] - наибольший суммарный вклад слов 0..i
+    std::vector<double> bound_sums(cursors.size());
+    double bound_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        bound_sum += cursors[i].upper_bound;
+        bound_sums[i] = bound_sum;
     }
-    return matched_documents;
-}
 
-template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, Predicate predicate) const {
-    return FindAllDocuments(query, predicate);
-}
+    if (cursors.empty()) {
+        return;
+    }
+    //Документы с минус-словами собираем до обхода и просто пропускаем их, не считая релевантность
+    std::vector<uint32_t> excluded;
+    {
+        LOG_STAGE(profile, QueryStage::MINUS_FILTERING);
+        excluded = CollectExcludedDocuments(FindMinusPostings(segment, query),
+            segment.GetFirstIndex(), segment.GetEndIndex(), term_frequencies);
+    }
+    ExclusionCursor exclusion(excluded);
+    LOG_STAGE(profile, QueryStage::POSTING_TRAVERSAL);
+    //Объём работы для профиля: просмотренные вхождения и документы с посчитанной релевантностью
+    uint64_t postings_scanned = 0;
+    uint64_t documents_scored = 0;
+
+    //Вклады слов в релевантность текущего документа по позициям в запросе и сами позиции
+    std::vector<double> contributions(query.plus_words.size());
+    std::vector<size_t> contributed;
+    contributed.reserve(cursors.size());
+    //Документ с релевантностью ниже порога не вытеснит ни один из отобранных
+    double threshold = -std::numeric_limits<double>::infinity();
+    //Слова [0, first_essential) необязательные
+    size_t first_essential = 0;
+    const auto raise_threshold = [&]() {
+        if (top_documents.IsFull()) {
+            //Отобранные документы, которые лучше худшего на EPSILON и больше, точно обгонят документ ниже порога
+            threshold = std::max(threshold, top_documents.GetWorst().relevance - 2 * EPSILON);
+            while (first_essential < cursors.size() && bound_sums[first_essential] < threshold) {
+                ++first_essential;
+            }
+        }
+    };
+    //Набор мог заполниться в предыдущих сегментах
+    raise_threshold();
+
+    //Сколько кандидатов осталось до следующей проверки срока
+    size_t deadline_countdown = DEADLINE_CHECK_INTERVAL;
+    while (true) {
+        if (deadline != nullptr && --deadline_countdown == 0) {
+            if (deadline->IsReached()) {
+                break;
+            }
+            deadline_countdown = DEADLINE_CHECK_INTERVAL;
+        }
+        uint32_t candidate = std::numeric_limits<uint32_t>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].postings.IsEnd()) {
+                candidate = std::min(candidate, cursors[i].postings.GetDocumentIndex());
+            }
+        }
+        if (candidate == std::numeric_limits<uint32_t>::max()) {
+            break;
+        }
 
-template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, Predicate predicate) const {
-    //    
-    std::vector<Document> matched_documents;
-    //<id, relevance> (relevance = sum(tf * idf))
-    ConcurrentMap<int, double> document_to_relevance_par(BUCKETS);
-
-    std::for_each(
-        std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, predicate, &document_to_relevance_par](auto& plus_word) {
-            if (word_to_document_freqs_.count(plus_word)) {
-                // IDF    
-                const double idf = CalculateIDF(plus_word);
-                for (const auto& [id_document, tf] : word_to_document_freqs_.find(plus_word)->second) {
-                    const auto& document_data = documents_.at(id_document);
-                    if (predicate(id_document, document_data.document_status, document_data.rating)) {
-                        //       -
-                        document_to_relevance_par[id_document].ref_to_value += tf * idf;
-                    }
+        const auto& document_data = segment.GetDocument(candidate);
+        const bool is_suitable = !exclusion.IsExcluded(candidate) && !segment.IsDeleted(candidate)
+            && predicate(document_data.id, document_data.document_status, document_data.rating);
+
+        contributed.clear();
+        double score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            TermCursor& cursor = cursors[i];
+            if (!cursor.postings.IsEnd() && cursor.postings.GetDocumentIndex() == candidate) {
+                if (is_suitable) {
+                    contributions[cursor.query_position] = cursor.postings.GetTf() * cursor.idf;
+                    contributed.push_back(cursor.query_position);
+                    score += contributions[cursor.query_position];
                 }
+                cursor.postings.Next();
+                ++postings_scanned;
             }
         }
-    );
+        if (!is_suitable) {
+            continue;
+        }
+
+        //Необязательные слова - от большей границы к меньшей, пока документ ещё может пройти порог.
+        //Сначала подходим к нужному блоку без распаковки: если документа в блок не попадает
+        //или граница блока не даёт пройти порог, блок так и не распаковывается
+        bool pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (score + bound_sums[i] < threshold) {
+                pruned = true;
+                break;
+            }
+            TermCursor& cursor = cursors[i];
+            cursor.postings.ShallowSkipTo(candidate);
+            if (cursor.postings.IsEnd() || cursor.postings.GetBlockFirstDocumentIndex() > candidate) {
+                continue;
+            }
+            const double rest_bound = i > 0 ? bound_sums[i - 1] : 0.0;
+            if (score + cursor.postings.GetBlockMaxTf() * cursor.idf + rest_bound < threshold) {
+                pruned = true;
+                break;
+            }
+            cursor.postings.SkipTo(candidate);
+            ++postings_scanned;
+            if (!cursor.postings.IsEnd() && cursor.postings.GetDocumentIndex() == candidate) {
+                contributions[cursor.query_position] = cursor.postings.GetTf() * cursor.idf;
+                contributed.push_back(cursor.query_position);
+                score += contributions[cursor.query_position];
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+
+        std::sort(contributed.begin(), contributed.end());
+        double relevance = 0.0;
+        for (const size_t position : contributed) {
+            relevance += contributions[position];
+        }
+        top_documents.Add({ document_data.id, relevance, document_data.rating });
+        ++documents_scored;
+        raise_threshold();
+    }
+    if (profile != nullptr) {
+        profile->AddPostingsScanned(postings_scanned);
+        profile->AddDocumentsScored(documents_scored);
+    }
+}
 
-    std::map<int, double> document_to_relevance = document_to_relevance_par.BuildOrdinaryMap();
 
-    std::for_each(
-        std::execution::par,
-        query.minus_words.begin(), query.minus_words.end(),
-        [this, predicate, &document_to_relevance](auto& minus_word) {
+//Документы делятся на непересекающиеся диапазоны внутренних индексов в пределах сегментов. Каждая часть
+//считает релевантность в накопителе своего потока и отбирает свои лучшие документы,
+//поэтому блокировок нет; в конце наборы частей сливаются в общий. Части выполняются на пуле политики.
+//Срок проверяется перед каждой частью: части, не начатые к сроку, пропускаются
+template <typename ExecutionPolicy, typename Predicate>
+void SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate,
+    TopDocuments& top_documents, SearchDeadline* deadline, QueryProfile* profile) const {
+    //IDF считаем один раз для всех частей
+    const std::vector<double> idfs = CalculateIDFs(query);
+
+    const std::vector<Partition> partitions = GetPartitions(GetThreadPool(policy).GetWorkerCount());
+    std::vector<TopDocuments> partition_tops(partitions.size(), TopDocuments(top_documents.GetMaxCount()));
 
-            if (word_to_document_freqs_.count(minus_word)) {
-                for (const auto& [id_document, relevance] : word_to_document_freqs_.find(minus_word)->second) {
-                    document_to_relevance.erase(id_document);
+    ForEach(
+        policy,
+        partitions.begin(), partitions.end(),
+        [&](const Partition& partition) {
+            if (deadline != nullptr && deadline->IsReached()) {
+                return;
+            }
+            LOG_TRACE("SearchPartition");
+            const auto& [segment, first, last] = partition;
+            const TermFrequencyTable& term_frequencies = segment->GetTermFrequencies();
+            //<список вхождений, IDF>
+            std::vector<std::pair<const PostingList*, double>> plus_postings;
+            for (size_t position = 0; position < query.plus_words.size(); ++position) {
+                const PostingList* postings = segment->FindPostings(query.plus_words[position]);
+                if (postings != nullptr) {
+                    plus_postings.push_back({ postings, idfs[position] });
                 }
             }
+            //Без плюс-слов искать нечего - списки минус-слов даже не открываем
+            if (plus_postings.empty()) {
+                return;
+            }
+            //Документы части с минус-словами: их вхождения плюс-слов пропускаем
+            std::vector<uint32_t> excluded;
+            {
+                LOG_STAGE(profile, QueryStage::MINUS_FILTERING);
+                excluded = CollectExcludedDocuments(FindMinusPostings(*segment, query), first, last, term_frequencies);
+            }
+            LOG_STAGE(profile, QueryStage::POSTING_TRAVERSAL);
+            uint64_t postings_scanned = 0;
+            //<индекс документа - first, relevance>
+            ScoreAccumulator& document_to_relevance = ScoreAccumulator::ForCurrentThread();
+            document_to_relevance.Reset(last - first);
+
+            for (const auto& [postings, idf] : plus_postings) {
+                ExclusionCursor exclusion(excluded);
+                postings->ForEachInRange(first, last, term_frequencies,
+                    [&, idf = idf](uint32_t document_index, double tf) {
+                        ++postings_scanned;
+                        if (exclusion.IsExcluded(document_index) || segment->IsDeleted(document_index)) {
+                            return;
+                        }
+                        const auto& document_data = segment->GetDocument(document_index);
+                        if (predicate(document_data.id, document_data.document_status, document_data.rating)) {
+                            document_to_relevance.Add(document_index - first, tf * idf);
+                        }
+                    }
+                );
+            }
+
+            TopDocuments& partition_top = partition_tops[&partition - partitions.data()];
+            for (const uint32_t offset : document_to_relevance.GetTouched()) {
+                const auto& document_data = segment->GetDocument(first + offset);
+                partition_top.Add({ document_data.id, document_to_relevance.GetScore(offset), document_data.rating });
+            }
+            if (profile != nullptr) {
+                profile->AddPostingsScanned(postings_scanned);
+                profile->AddDocumentsScored(document_to_relevance.GetTouched().size());
+            }
         }
     );
 
-    matched_documents.reserve(document_to_relevance.size());
-
-    //    Document
-    for (const auto& [id_document, relevance] : document_to_relevance) {
-        matched_documents.push_back({ id_document, relevance, documents_.at(id_document).rating });
+    LOG_STAGE(profile, QueryStage::RANKING);
+    for (const TopDocuments& partition_top : partition_tops) {
+        top_documents.Merge(partition_top);
     }
-
-    return matched_documents;
 }
 
 
 template <typename ExecutionPolicy, typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const {
-    //      ParseQuery (ParseQueryWord)
-    const Query query = ParseQuerySeq(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, predicate);
-    //   ...
-    std::sort(
-        policy,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            //... ,   
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            //... 
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+    size_t max_result_count) const {
+    //Предикат без состояния отбирает одно и то же, пока не меняется его тип
+    std::optional<ResultCache::Filter> filter;
+    if constexpr (std::is_empty_v<Predicate>) {
+        filter = std::type_index(typeid(Predicate));
+    }
+    return FindQueryTopDocuments(policy, raw_query, predicate, max_result_count, filter);
+}
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindQueryTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+    size_t max_result_count, const std::optional<ResultCache::Filter>& filter, SearchDeadline* deadline) const {
+    LOG_TRACE("FindTopDocuments");
+    std::optional<QueryProfile> profile;
+    if (IsQueryMetricsEnabled()) {
+        profile.emplace();
     }
-    return matched_documents;
+    QueryProfile* const query_profile = profile ? &*profile : nullptr;
+
+    Query query;
+    {
+        LOG_STAGE(query_profile, QueryStage::PARSE);
+        //Теперь валидность поискового запроса проверяется внутри ParseQuery (ParseQueryWord)
+        query = ParseQuerySeq(raw_query);
+    }
+    //При K = 0 отбирать нечего; пустой набор из 0 документов уже полон, и порог по худшему из него не взять
+    if (max_result_count == 0) {
+        if (profile) {
+            profile->Finish();
+        }
+        return {};
+    }
+    std::optional<ResultCache::Key> key;
+    if (result_cache_ != nullptr && filter) {
+        key = ResultCache::Key{ GetQueryKey(query), *filter, max_result_count,
+            IS_PARALLEL_POLICY<ExecutionPolicy> };
+        if (auto documents = result_cache_->Find(*key, generation_)) {
+            if (profile) {
+                profile->Finish();
+            }
+            return std::move(*documents);
+        }
+    }
+    //Найденные документы сразу отбираются по невозрастанию релевантности (и рейтинга), без полной сортировки
+    TopDocuments top_documents(max_result_count);
+    FindAllDocuments(policy, query, predicate, top_documents, deadline, query_profile);
+    std::vector<Document> documents;
+    {
+        LOG_STAGE(query_profile, QueryStage::RANKING);
+        documents = top_documents.Extract();
+    }
+    if (key && (deadline == nullptr || !deadline->WasReached())) {
+        result_cache_->Insert(std::move(*key), generation_, documents);
+    }
+    if (profile) {
+        profile->Finish();
+    }
+    return documents;
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, predicate);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate, size_t max_result_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, predicate, max_result_count);
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+    size_t max_result_count) const {
+    return FindQueryTopDocuments(
         policy, raw_query,
-        [status](int id_document, DocumentStatus document_status, int rating) {
+        [status](int, DocumentStatus document_status, int) {
             return document_status == status;
-        }
+        },
+        max_result_count, ResultCache::Filter(status)
     );
 }
 
 
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+    size_t max_result_count, SearchDeadline& deadline) const {
+    return FindQueryTopDocuments(
+        policy, raw_query,
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        },
+        max_result_count, ResultCache::Filter(status), &deadline
+    );
+}
+
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
@@ -295,31 +724,6 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
 
 
 template <typename ExecutionPolicy>
-void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (!ids_.count(document_id)) {
-        return;
-    }
-
-    std::vector<std::string_view> words_to_delete(document_to_word_freqs_.at(document_id).size());
-
-    std::transform(
-        policy,
-        document_to_word_freqs_.at(document_id).begin(), document_to_word_freqs_.at(document_id).end(),
-        words_to_delete.begin(),
-        [](auto& word) {
-            return word.first;
-        }
-    );
-
-    std::for_each(
-        policy,
-        words_to_delete.begin(), words_to_delete.end(),
-        [this, document_id](auto& word_to_delete) {
-            word_to_document_freqs_.find(word_to_delete)->second.erase(document_id);
-        }
-    );
-
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    ids_.erase(document_id);
-}
\ No newline at end of file
+void SearchServer::RemoveDocument(ExecutionPolicy&&, int document_id) {
+    RemoveDocument(document_id);
+}
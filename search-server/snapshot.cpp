@@ -0,0 +1,176 @@
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "snapshot.h"
+
+
+using namespace std::string_literals;
+
+
+namespace {
+
+//Массивы снимка начинаются с адресов, кратных ALIGNMENT
+constexpr size_t ALIGNMENT = 8;
+constexpr char MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+//Прочитанная на машине с другим порядком байт метка не совпадёт
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+size_t AlignUp(size_t size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+} // namespace
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Can't open snapshot "s + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0
+        || (mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr)) == nullptr
+        || (data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0))) == nullptr) {
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw std::runtime_error("Can't map snapshot "s + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Can't open snapshot "s + path);
+    }
+    struct stat file_stat;
+    void* data = MAP_FAILED;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, file, 0);
+    }
+    //Отображение остаётся действительным и после закрытия файла
+    close(file);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Can't map snapshot "s + path);
+    }
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(file_stat.st_size);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
+
+
+SnapshotWriter::SnapshotWriter(std::ostream& out)
+    : out_(out) {
+}
+
+void SnapshotWriter::WriteHeader() {
+    WriteArray(MAGIC, sizeof(MAGIC));
+    Write(SNAPSHOT_VERSION);
+    Write(BYTE_ORDER_MARK);
+}
+
+void SnapshotWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> ends;
+    ends.reserve(strings.size());
+    uint64_t end = 0;
+    for (std::string_view str : strings) {
+        end += str.size();
+        ends.push_back(end);
+    }
+    Write(static_cast<uint64_t>(strings.size()));
+    WriteArray(ends.data(), ends.size());
+    std::string chars;
+    chars.reserve(end);
+    for (std::string_view str : strings) {
+        chars.append(str);
+    }
+    WriteArray(chars.data(), chars.size());
+}
+
+void SnapshotWriter::WriteBytes(const char* data, size_t size) {
+    static constexpr char PADDING[ALIGNMENT] = {};
+    out_.write(data, size);
+    out_.write(PADDING, AlignUp(size) - size);
+    if (!out_) {
+        throw std::runtime_error("Can't write snapshot"s);
+    }
+}
+
+
+SnapshotReader::SnapshotReader(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+void SnapshotReader::ReadHeader() {
+    const char* magic = ReadArray<char>(sizeof(MAGIC));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::invalid_argument("File is not a search server snapshot"s);
+    }
+    const uint32_t version = Read<uint32_t>();
+    if (Read<uint32_t>() != BYTE_ORDER_MARK) {
+        throw std::invalid_argument("Snapshot was written with another byte order"s);
+    }
+    if (version != SNAPSHOT_VERSION) {
+        throw std::invalid_argument("Unsupported snapshot version "s + std::to_string(version));
+    }
+}
+
+std::vector<std::string_view> SnapshotReader::ReadStrings() {
+    const uint64_t count = Read<uint64_t>();
+    const uint64_t* ends = ReadArray<uint64_t>(count);
+    const uint64_t chars_size = count == 0 ? 0 : ends[count - 1];
+    const char* chars = ReadArray<char>(chars_size);
+
+    std::vector<std::string_view> strings;
+    strings.reserve(count);
+    uint64_t begin = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (ends[i] < begin || ends[i] > chars_size) {
+            ThrowTruncated();
+        }
+        strings.emplace_back(chars + begin, ends[i] - begin);
+        begin = ends[i];
+    }
+    return strings;
+}
+
+const char* SnapshotReader::ReadBytes(size_t size) {
+    const size_t padded_size = AlignUp(size);
+    if (padded_size > size_ - position_) {
+        ThrowTruncated();
+    }
+    const char* data = data_ + position_;
+    position_ += padded_size;
+    return data;
+}
+
+void SnapshotReader::ThrowTruncated() {
+    throw std::invalid_argument("Snapshot is truncated or corrupted"s);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+//Версия формата снимка индекса; меняется при любом изменении раскладки файла
+const uint32_t SNAPSHOT_VERSION = 3;
+
+//Файл, отображённый в память только для чтения. Данные доступны, пока жив объект
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* GetData() const {
+        return data_;
+    }
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+
+//Запись снимка. Все значения пишутся в представлении машины, а каждый массив выравнивается
+//на 8 байт, поэтому после отображения файла массивы читаются без копирования
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& out);
+
+    //Метка формата, версия и порядок байт
+    void WriteHeader();
+
+    template <typename T>
+    void Write(const T& value) {
+        WriteArray(&value, 1);
+    }
+
+    template <typename T>
+    void WriteArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    //Количество строк, смещения их концов и сами символы подряд
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+private:
+    void WriteBytes(const char* data, size_t size);
+
+    std::ostream& out_;
+};
+
+
+//Чтение снимка прямо из отображённой памяти: возвращаются указатели внутрь файла.
+//Выход за границы файла или чужой формат - исключение std::invalid_argument
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size);
+
+    void ReadHeader();
+
+    template <typename T>
+    T Read() {
+        return *ReadArray<T>(1);
+    }
+
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (count > (size_ - position_) / sizeof(T)) {
+            ThrowTruncated();
+        }
+        return reinterpret_cast<const T*>(ReadBytes(count * sizeof(T)));
+    }
+
+    //Представления указывают в отображённый файл
+    std::vector<std::string_view> ReadStrings();
+
+    //Весь ли файл прочитан
+    bool IsEnd() const {
+        return position_ == size_;
+    }
+
+private:
+    const char* ReadBytes(size_t size);
+    [[noreturn]] static void ThrowTruncated();
+
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
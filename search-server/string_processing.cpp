@@ -1,7 +1,19 @@
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "string_processing.h"
 
 
-//     
+//Формируем вектор из строки с пробелами
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
     std::string word;
@@ -25,14 +37,121 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> result;
-    text.remove_prefix(std::min(text.size(), text.find_first_not_of(' ')));
+    SplitIntoWords(text, result);
+    return result;
+}
+
+
+namespace {
+
+#if defined(__AVX2__)
+constexpr size_t CHUNK_SIZE = 32;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+constexpr size_t CHUNK_SIZE = 16;
+#else
+constexpr size_t CHUNK_SIZE = 0;
+#endif
+
+int CountTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+//Маски блока из CHUNK_SIZE байт: бит i - байт i пробел / управляющий символ
+struct ChunkMasks {
+    uint32_t spaces;
+    uint32_t controls;
+};
+
+ChunkMasks ScanChunk(const char* data) {
+#if defined(__AVX2__)
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i spaces = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    //Беззнаковое x <= 0x1F - это min(x, 0x1F) == x
+    const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(0x1F)), bytes);
+    return { static_cast<uint32_t>(_mm256_movemask_epi8(spaces)), static_cast<uint32_t>(_mm256_movemask_epi8(controls)) };
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i spaces = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x1F)), bytes);
+    return { static_cast<uint32_t>(_mm_movemask_epi8(spaces)), static_cast<uint32_t>(_mm_movemask_epi8(controls)) };
+#else
+    static_cast<void>(data);
+    return { 0, 0 };
+#endif
+}
+
+} // namespace
+
 
-    while (!text.empty()) {
+// Границы слов - смены "пробел / не пробел". В блоке они находятся сразу все: маска пробелов, сдвинутая
+// на байт (бит 0 - последний байт предыдущего блока), отличается от исходной ровно на границах
+size_t SplitIntoWords(std::string_view text, std::vector<std::string_view>& words) {
+    const size_t first_word = words.size();
+    const char* const data = text.data();
+    //Начало текущего слова; text.size(), пока идут пробелы
+    size_t word_begin = text.size();
+    size_t first_control = text.size();
+    size_t position = 0;
 
-        int64_t space = text.find(' ');
-        result.push_back(text.substr(0, space));
+    if constexpr (CHUNK_SIZE > 0) {
+        uint32_t previous_is_space = 1;
+        for (; position + CHUNK_SIZE <= text.size(); position += CHUNK_SIZE) {
+            const ChunkMasks masks = ScanChunk(data + position);
+            if (masks.controls != 0 && first_control == text.size()) {
+                first_control = position + CountTrailingZeros(masks.controls);
+            }
+            uint32_t boundaries = masks.spaces ^ ((masks.spaces << 1) | previous_is_space);
+            previous_is_space = masks.spaces >> (CHUNK_SIZE - 1);
+            if constexpr (CHUNK_SIZE < 32) {
+                boundaries &= (1u << CHUNK_SIZE) - 1;
+            }
+            while (boundaries != 0) {
+                const size_t boundary = position + CountTrailingZeros(boundaries);
+                boundaries &= boundaries - 1;
+                if (data[boundary] != ' ') {
+                    word_begin = boundary;
+                }
+                else {
+                    words.emplace_back(data + word_begin, boundary - word_begin);
+                    word_begin = text.size();
+                }
+            }
+        }
+    }
+
+    //Остаток короче блока (или вся строка без SIMD)
+    for (; position < text.size(); ++position) {
+        const unsigned char c = static_cast<unsigned char>(data[position]);
+        if (c == ' ') {
+            if (word_begin != text.size()) {
+                words.emplace_back(data + word_begin, position - word_begin);
+                word_begin = text.size();
+            }
+            continue;
+        }
+        if (c < ' ' && first_control == text.size()) {
+            first_control = position;
+        }
+        if (word_begin == text.size()) {
+            word_begin = position;
+        }
+    }
+    if (word_begin != text.size()) {
+        words.emplace_back(data + word_begin, text.size() - word_begin);
+    }
 
-        text.remove_prefix(std::min(text.size(), text.find_first_not_of(' ', space)));
+    if (first_control == text.size()) {
+        return words.size();
     }
-    return result;
+    //Управляющий символ - не пробел, поэтому лежит внутри слова: первое слово, которое кончается после него
+    return static_cast<size_t>(std::partition_point(words.begin() + first_word, words.end(),
+        [data, first_control](std::string_view word) {
+            return static_cast<size_t>(word.data() + word.size() - data) <= first_control;
+        }) - words.begin());
 }
@@ -6,10 +6,16 @@
 #include <set>
 
 
-//     
+//Формируем вектор из строки с пробелами
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+//Разбиваем строку на слова по пробелам и за тот же проход ищем управляющие символы (коды меньше ' ').
+//Слова дописываются в конец words, поэтому один буфер можно переиспользовать для многих строк.
+//Возвращаем номер (в words) первого слова с управляющим символом или words.size(), если таких нет.
+//Строка просматривается по 32 (AVX2) или 16 (SSE2) байт за шаг, без SIMD - побайтно
+size_t SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& text) {
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "term_dictionary.h"
+
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : arena_blocks_(other.arena_blocks_)
+    //Хвост последнего блока остаётся оригиналу - копия начнёт свой блок с самого маленького
+    , block_size_(0)
+    , block_used_(0)
+    , arena_size_(other.arena_size_)
+    , terms_(other.terms_)
+    , slots_(other.slots_) {
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        *this = TermDictionary(other);
+    }
+    return *this;
+}
+
+TermId TermDictionary::Find(std::string_view term) const {
+    return slots_.empty() ? NO_TERM : slots_[FindSlot(term, Hash(term))].term_id;
+}
+
+TermId TermDictionary::Insert(std::string_view term) {
+    const uint32_t hash = Hash(term);
+    if (!slots_.empty()) {
+        const TermId term_id = slots_[FindSlot(term, hash)].term_id;
+        if (term_id != NO_TERM) {
+            return term_id;
+        }
+    }
+    return Register(Store(term), hash);
+}
+
+TermId TermDictionary::InsertMapped(std::string_view term) {
+    const uint32_t hash = Hash(term);
+    if (!slots_.empty()) {
+        const TermId term_id = slots_[FindSlot(term, hash)].term_id;
+        if (term_id != NO_TERM) {
+            return term_id;
+        }
+    }
+    return Register(term, hash);
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return terms_[term_id];
+}
+
+size_t TermDictionary::GetTermCount() const {
+    return terms_.size();
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return arena_size_ + terms_.capacity() * sizeof(std::string_view) + slots_.capacity() * sizeof(Slot);
+}
+
+// Старшие и младшие биты хеша смешиваем: номер ячейки берётся из младших
+uint32_t TermDictionary::Hash(std::string_view term) {
+    const uint64_t hash = std::hash<std::string_view>{}(term);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// Линейное пробирование: таблица заполнена не больше чем наполовину, поэтому пустая ячейка всегда найдётся
+size_t TermDictionary::FindSlot(std::string_view term, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = hash & mask;
+    while (slots_[slot].term_id != NO_TERM
+        && (slots_[slot].hash != hash || terms_[slots_[slot].term_id] != term)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+TermId TermDictionary::Register(std::string_view stored, uint32_t hash) {
+    if (2 * (terms_.size() + 1) > slots_.size()) {
+        Rehash(std::max(MIN_SLOT_COUNT, 2 * slots_.size()));
+    }
+    const TermId term_id = static_cast<TermId>(terms_.size());
+    terms_.push_back(stored);
+    //Слова ещё нет в словаре - поиск остановится на пустой ячейке
+    slots_[FindSlot(stored, hash)] = { term_id, hash };
+    return term_id;
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    std::vector<Slot> slots(slot_count);
+    const size_t mask = slot_count - 1;
+    for (const Slot& old_slot : slots_) {
+        if (old_slot.term_id == NO_TERM) {
+            continue;
+        }
+        size_t slot = old_slot.hash & mask;
+        while (slots[slot].term_id != NO_TERM) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = old_slot;
+    }
+    slots_ = std::move(slots);
+}
+
+std::string_view TermDictionary::Store(std::string_view term) {
+    if (block_size_ == 0 || term.size() > block_size_ - block_used_) {
+        //Старый блок не освобождаем: на него указывают уже выданные слова
+        block_size_ = std::max(term.size(), std::min(ARENA_BLOCK_SIZE, std::max(MIN_ARENA_BLOCK_SIZE, 2 * block_size_)));
+        arena_blocks_.push_back(std::shared_ptr<char[]>(new char[block_size_]));
+        arena_size_ += block_size_;
+        block_used_ = 0;
+    }
+    char* data = arena_blocks_.back().get() + block_used_;
+    std::memcpy(data, term.data(), term.size());
+    block_used_ += term.size();
+    return { data, term.size() };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+//Постоянный идентификатор слова в словаре
+using TermId = uint32_t;
+
+//Словарь слов индекса. Строки лежат подряд в общих блоках памяти (арене),
+//каждому слову выдаётся 32-битный идентификатор, который не меняется,
+//пока слово есть в словаре. Поиск слова - по хеш-таблице с открытой адресацией: вся таблица -
+//один массив, отдельного узла на слово нет.
+//Копии словаря делят блоки арены: записанные слова не меняются, а новые слова
+//копия пишет уже в свои блоки, поэтому копию можно читать, пока оригинал дополняется
+class TermDictionary {
+public:
+    //Идентификатор, который возвращается для отсутствующего слова
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermDictionary() = default;
+
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    //Идентификатор слова или NO_TERM, если слова нет
+    TermId Find(std::string_view term) const;
+
+    //Идентификатор слова; отсутствующее слово копируется в арену и получает новый идентификатор
+    TermId Insert(std::string_view term);
+
+    //Идентификатор слова, которое уже лежит в памяти, живущей дольше словаря (в отображённом снимке):
+    //слово не копируется в арену, словарь ссылается прямо на эту память
+    TermId InsertMapped(std::string_view term);
+
+    //Слово по идентификатору; представление живёт столько же, сколько словарь
+    std::string_view GetTerm(TermId term_id) const;
+
+    //Сколько идентификаторов выдано
+    size_t GetTermCount() const;
+
+    //Сколько байт кучи занимает словарь (оценка). Блоки арены, общие с копиями, считаются целиком
+    size_t GetMemoryUsage() const;
+
+private:
+    //Блоки арены растут вдвое от MIN_ARENA_BLOCK_SIZE до ARENA_BLOCK_SIZE: копия, в которую
+    //допишут лишь несколько слов, не держит целый большой блок. Слово длиннее блока получает собственный блок
+    static constexpr size_t MIN_ARENA_BLOCK_SIZE = 256;
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+    //Ячейка хеш-таблицы: идентификатор слова (NO_TERM - ячейка пуста) и хеш слова.
+    //Хеш сравнивается раньше строки и нужен, чтобы переложить таблицу, не хешируя слова заново
+    struct Slot {
+        TermId term_id = NO_TERM;
+        uint32_t hash = 0;
+    };
+
+    //Наименьший размер таблицы; таблица заполнена не больше чем наполовину
+    static constexpr size_t MIN_SLOT_COUNT = 16;
+
+    static uint32_t Hash(std::string_view term);
+
+    //Ячейка слова или пустая ячейка, в которой поиск слова остановился (таблица не пуста)
+    size_t FindSlot(std::string_view term, uint32_t hash) const;
+
+    //Копируем строку в арену
+    std::string_view Store(std::string_view term);
+
+    //Выдаём идентификатор слову, которое хранится по адресу stored
+    TermId Register(std::string_view stored, uint32_t hash);
+
+    //Перекладываем слова в таблицу из slot_count ячеек (степень двойки)
+    void Rehash(size_t slot_count);
+
+    std::vector<std::shared_ptr<char[]>> arena_blocks_;
+    //Размер и заполненность своего последнего блока (0 - своего блока ещё нет)
+    size_t block_size_ = 0;
+    size_t block_used_ = 0;
+    //Суммарный размер блоков арены
+    size_t arena_size_ = 0;
+
+    //<идентификатор, слово>
+    std::vector<std::string_view> terms_;
+    //<слово, идентификатор>: ячейки по хешу слова, число ячеек - степень двойки
+    std::vector<Slot> slots_;
+};
@@ -0,0 +1,139 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "thread_pool.h"
+
+
+namespace {
+
+//Пул и номер потока, в котором выполняется код (nullptr - поток не из пула)
+thread_local ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+void PinThread(std::thread& thread, size_t cpu) {
+#if defined(_WIN32)
+    SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << (cpu % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+    //Закрепление не поддерживается - поток остаётся на выбор планировщика
+    (void)thread;
+    (void)cpu;
+#endif
+}
+
+}
+
+ThreadPool::ThreadPool(size_t worker_count, bool pin_workers) {
+    const size_t cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    if (worker_count == 0) {
+        worker_count = cpu_count;
+    }
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    //Очереди создаются до запуска потоков: поток сразу может перехватывать задачи соседей
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_[i]->thread = std::thread([this, i] { Work(i); });
+        if (pin_workers) {
+            PinThread(workers_[i]->thread, i % cpu_count);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wake_.notify_all();
+    for (const auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::GetDefault() {
+    static ThreadPool pool;
+    return pool;
+}
+
+PoolPolicy ThreadPool::GetPolicy() {
+    return { this };
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    const size_t worker_index = current_pool == this ? current_worker : next_worker_++ % workers_.size();
+    //Счётчик растёт раньше, чем задача попадает в очередь, поэтому он не бывает меньше числа задач
+    ++queued_count_;
+    {
+        std::lock_guard guard(workers_[worker_index]->mutex);
+        workers_[worker_index]->tasks.push_back(std::move(task));
+    }
+    //Спящий поток проверяет счётчик под sleep_mutex_ - без захвата он мог бы пропустить сигнал
+    {
+        std::lock_guard guard(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::RunPendingTask() {
+    std::function<void()> task;
+    if (!PopTask(task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool ThreadPool::PopTask(std::function<void()>& task) {
+    if (queued_count_ == 0) {
+        return false;
+    }
+    const bool is_worker = current_pool == this;
+    if (is_worker) {
+        Worker& own = *workers_[current_worker];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued_count_;
+            return true;
+        }
+    }
+    const size_t first = is_worker ? current_worker + 1 : 0;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(first + i) % workers_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued_count_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Work(size_t worker_index) {
+    current_pool = this;
+    current_worker = worker_index;
+    while (true) {
+        if (RunPendingTask()) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return is_stopping_ || queued_count_ > 0; });
+        if (is_stopping_ && queued_count_ == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "log_duration.h"
+
+struct PoolPolicy;
+
+//Пул потоков с перехватом задач (work stealing). У каждого потока своя очередь: поток берёт задачи
+//с её конца (последние поставленные - их данные ещё в кэше), а простаивающий поток забирает
+//самые старые задачи из очередей других потоков.
+//Поток, который ждёт завершения своих задач (ParallelFor), сначала выполняет задачи пула и засыпает,
+//только когда их нет, а его вызовы ещё выполняются в других потоках. Поэтому вложенный параллелизм (параллельный запрос внутри параллельной обработки запросов)
+//не создаёт новых потоков и не ждёт сам себя: работают только потоки пула и вызывающие потоки
+class ThreadPool {
+public:
+    //worker_count = 0 - по потоку на ядро. С pin_workers поток i закрепляется за ядром i % число ядер
+    explicit ThreadPool(size_t worker_count = 0, bool pin_workers = false);
+    //Выполняем поставленные задачи и останавливаем потоки
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //Пул, на котором выполняется std::execution::par: по потоку на ядро, без закрепления
+    static ThreadPool& GetDefault();
+
+    size_t GetWorkerCount() const {
+        return workers_.size();
+    }
+
+    //Политика выполнения на этом пуле - передаётся вместо std::execution::par
+    PoolPolicy GetPolicy();
+
+    //Ставим задачу (она не должна выбрасывать исключений): из потока этого пула - в его очередь,
+    //иначе - в очереди потоков по кругу
+    void Submit(std::function<void()> task);
+
+    //Выполняем одну поставленную задачу (свою или перехваченную); false - задач нет
+    bool RunPendingTask();
+
+    //Вызываем function(i) для каждого i из [0, count) и ждём завершения всех вызовов.
+    //Номера разбираются динамически вызывающим потоком и потоками пула; исключение первого
+    //упавшего вызова выбрасывается после завершения остальных (ещё не начатые вызовы пропускаются)
+    template <typename Function>
+    void ParallelFor(size_t count, Function function);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    //Состояние ParallelFor; живёт, пока его держит хоть одна задача-помощник
+    struct ForState {
+        std::atomic<size_t> next_index{ 0 };
+        std::atomic<size_t> remaining_count{ 0 };
+        std::atomic<bool> has_error{ false };
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        //Будит вызывающий поток, когда завершён последний вызов
+        std::mutex done_mutex;
+        std::condition_variable done;
+    };
+
+    void Work(size_t worker_index);
+
+    //Забираем задачу: свою с конца или чужую с начала
+    bool PopTask(std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    //Сколько задач стоит в очередях
+    std::atomic<size_t> queued_count_{ 0 };
+    //Очередь для Submit из чужих потоков выбирается по кругу
+    std::atomic<size_t> next_worker_{ 0 };
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool is_stopping_ = false;
+};
+
+
+//Политика выполнения на заданном пуле. Принимается везде, где std::execution::par
+struct PoolPolicy {
+    ThreadPool* pool;
+};
+
+//Параллельна ли политика: std::execution::par и PoolPolicy
+template <typename ExecutionPolicy>
+constexpr bool IS_PARALLEL_POLICY = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>
+    || std::is_same_v<std::decay_t<ExecutionPolicy>, PoolPolicy>;
+
+//Пул параллельной политики
+inline ThreadPool& GetThreadPool(const std::execution::parallel_policy&) {
+    return ThreadPool::GetDefault();
+}
+inline ThreadPool& GetThreadPool(const PoolPolicy& policy) {
+    return *policy.pool;
+}
+
+//Замена std::for_each(policy, ...): параллельные политики выполняются на пуле
+template <typename ExecutionPolicy, typename RandomIt, typename Function>
+void ForEach(const ExecutionPolicy& policy, RandomIt first, RandomIt last, Function function) {
+    if constexpr (IS_PARALLEL_POLICY<ExecutionPolicy>) {
+        GetThreadPool(policy).ParallelFor(static_cast<size_t>(last - first),
+            [first, &function](size_t i) { function(first[i]); });
+    }
+    else {
+        std::for_each(first, last, function);
+    }
+}
+
+
+// Вызывающий поток разбирает номера наравне с помощниками, поэтому цикл завершится, даже если ни один
+// помощник так и не запустится; опоздавший помощник находит номера разобранными и сразу выходит
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function) {
+    if (count == 0) {
+        return;
+    }
+    auto state = std::make_shared<ForState>();
+    state->remaining_count = count;
+    const auto run = [state, count, &function]() {
+        for (size_t i = state->next_index++; i < count; i = state->next_index++) {
+            if (!state->has_error) {
+                try {
+                    function(i);
+                }
+                catch (...) {
+                    std::lock_guard guard(state->error_mutex);
+                    if (!state->has_error) {
+                        state->error = std::current_exception();
+                        state->has_error = true;
+                    }
+                }
+            }
+            if (--state->remaining_count == 0) {
+                std::lock_guard guard(state->done_mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    const size_t helper_count = std::min(workers_.size(), count - 1);
+#ifdef SEARCH_SERVER_NO_TRACING
+    for (size_t i = 0; i < helper_count; ++i) {
+        Submit(run);
+    }
+#else
+    //В трассировке работа помощника отмечается именем области, из которой запущен цикл.
+    //Имя строится и копируется в задачи, только если запись включена
+    if (!IsTracingEnabled()) {
+        for (size_t i = 0; i < helper_count; ++i) {
+            Submit(run);
+        }
+    }
+    else {
+        const std::string_view scope_name = GetTraceScopeName();
+        const TraceName trace_name(scope_name.empty() ? std::string_view("ParallelFor") : scope_name);
+        for (size_t i = 0; i < helper_count; ++i) {
+            Submit([run, state, count, trace_name]() {
+                if (state->next_index >= count) {
+                    return;
+                }
+                TraceScope trace_scope(trace_name);
+                run();
+            });
+        }
+    }
+#endif
+    run();
+    //Номера, взятые помощниками, ещё могут выполняться - пока ждём, выполняем другие задачи, а без них спим.
+    //Все номера уже разобраны, поэтому оставшиеся вызовы завершатся и без этого потока
+    while (state->remaining_count > 0) {
+        if (RunPendingTask()) {
+            continue;
+        }
+        std::unique_lock lock(state->done_mutex);
+        state->done.wait(lock, [&state] { return state->remaining_count == 0; });
+    }
+    if (state->has_error) {
+        std::rethrow_exception(state->error);
+    }
+}
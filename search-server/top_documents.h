@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "document.h"
+
+
+//Допустимая погрешнось по релевантности
+const double EPSILON = 1e-6;
+
+//Порядок выдачи: по убыванию релевантности, при равной (с точностью EPSILON) - по убыванию рейтинга
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+//Отбор K лучших документов ограниченной кучей: O(n log K) вместо полной сортировки.
+//На вершине кучи лежит худший из отобранных документов
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count);
+
+    //Предлагаем документ; он останется, если лучше худшего из отобранных
+    void Add(const Document& document);
+
+    //Забираем документы другого набора (результат параллельной части)
+    void Merge(const TopDocuments& other);
+
+    //Сколько документов отбираем
+    size_t GetMaxCount() const;
+
+    //Набрано ли уже K документов
+    bool IsFull() const;
+
+    //Худший из отобранных документов (набор не должен быть пуст)
+    const Document& GetWorst() const;
+
+    //Отобранные документы от лучшего к худшему
+    std::vector<Document> Extract();
+
+private:
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
+
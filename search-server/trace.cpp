@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "trace.h"
+
+using namespace std::string_literals;
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t GetTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+std::atomic<bool> is_tracing_enabled{ false };
+
+struct TraceEvent {
+    TraceName name;
+    int64_t time_ns;
+    bool is_begin;
+};
+
+//Кольцевой буфер потока. Пишет в него только свой поток, мьютекс нужен для очистки и выгрузки,
+//поэтому обычно он свободен
+struct ThreadTrace {
+    std::mutex mutex;
+    //Память выделяется при первом событии
+    std::vector<TraceEvent> events;
+    //Событий записано с последней очистки; следующее пишется в events[event_count % TRACE_BUFFER_SIZE]
+    uint64_t event_count = 0;
+    //Номер потока в трассе
+    size_t thread_number = 0;
+    //Занят ли живым потоком (под Registry::mutex)
+    bool is_used = false;
+
+    void Add(const TraceEvent& event) {
+        std::lock_guard guard(mutex);
+        if (events.empty()) {
+            events.resize(TRACE_BUFFER_SIZE);
+        }
+        events[event_count++ % TRACE_BUFFER_SIZE] = event;
+    }
+};
+
+//Буферы всех потоков. Буфер завершившегося потока сохраняет события и переходит к следующему новому потоку.
+//Реестр не освобождается: потоки пулов могут завершаться уже после статических объектов
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTrace>> thread_traces;
+    //Время запуска записи (под mutex)
+    int64_t start_time_ns = 0;
+};
+
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+class ThreadTraceOwner {
+public:
+    ThreadTrace& Get() {
+        if (trace_ == nullptr) {
+            Registry& registry = GetRegistry();
+            std::lock_guard guard(registry.mutex);
+            for (const auto& trace : registry.thread_traces) {
+                if (!trace->is_used) {
+                    trace_ = trace.get();
+                    break;
+                }
+            }
+            if (trace_ == nullptr) {
+                registry.thread_traces.push_back(std::make_unique<ThreadTrace>());
+                trace_ = registry.thread_traces.back().get();
+                trace_->thread_number = registry.thread_traces.size();
+            }
+            trace_->is_used = true;
+        }
+        return *trace_;
+    }
+
+    std::vector<TraceName>& GetOpenScopes() {
+        return open_scopes_;
+    }
+
+    ~ThreadTraceOwner() {
+        if (trace_ != nullptr) {
+            std::lock_guard guard(GetRegistry().mutex);
+            trace_->is_used = false;
+        }
+    }
+
+private:
+    ThreadTrace* trace_ = nullptr;
+    std::vector<TraceName> open_scopes_;
+};
+
+thread_local ThreadTraceOwner thread_trace;
+
+//Строка JSON. Байты не из ASCII записываются как символы Latin-1: имена не обязаны быть в UTF-8,
+//а файл должен остаться корректным JSON
+void WriteJsonString(std::ostream& out, std::string_view text) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    out << '"';
+    for (const char c : text) {
+        const unsigned char code = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (code < 0x20 || code >= 0x80) {
+            out << "\\u00"s << HEX_DIGITS[code >> 4] << HEX_DIGITS[code & 0xf];
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+//Время в микросекундах с тремя знаками после точки
+void WriteTimestamp(std::ostream& out, int64_t time_ns) {
+    time_ns = std::max<int64_t>(0, time_ns);
+    out << time_ns / 1000 << '.' << std::setw(3) << std::setfill('0') << time_ns % 1000 << std::setfill(' ');
+}
+
+}
+
+TraceName::TraceName(std::string_view name)
+    : size_(static_cast<uint8_t>(std::min(name.size(), TRACE_NAME_SIZE - 1))) {
+    std::copy(name.begin(), name.begin() + size_, text_);
+}
+
+std::string_view TraceName::GetView() const {
+    return { text_, size_ };
+}
+
+bool TraceName::IsEmpty() const {
+    return size_ == 0;
+}
+
+void StartTracing() {
+    Registry& registry = GetRegistry();
+    {
+        std::lock_guard guard(registry.mutex);
+        registry.start_time_ns = GetTimeNs();
+        for (const auto& trace : registry.thread_traces) {
+            std::lock_guard trace_guard(trace->mutex);
+            trace->event_count = 0;
+        }
+    }
+    is_tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() {
+    is_tracing_enabled.store(false, std::memory_order_relaxed);
+}
+
+bool IsTracingEnabled() {
+    return is_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void TraceBegin(std::string_view name) {
+    const TraceName trace_name(name);
+    thread_trace.GetOpenScopes().push_back(trace_name);
+    thread_trace.Get().Add({ trace_name, GetTimeNs(), true });
+}
+
+void TraceEnd() {
+    std::vector<TraceName>& open_scopes = thread_trace.GetOpenScopes();
+    if (open_scopes.empty()) {
+        return;
+    }
+    thread_trace.Get().Add({ open_scopes.back(), GetTimeNs(), false });
+    open_scopes.pop_back();
+}
+
+std::string_view GetTraceScopeName() {
+    const std::vector<TraceName>& open_scopes = thread_trace.GetOpenScopes();
+    return open_scopes.empty() ? std::string_view() : open_scopes.back().GetView();
+}
+
+void WriteTrace(std::ostream& out) {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    out << "{\"traceEvents\":["s;
+    bool is_first = true;
+    for (const auto& trace : registry.thread_traces) {
+        std::vector<TraceEvent> events;
+        {
+            std::lock_guard trace_guard(trace->mutex);
+            const uint64_t count = std::min<uint64_t>(trace->event_count, TRACE_BUFFER_SIZE);
+            events.reserve(count);
+            for (uint64_t i = trace->event_count - count; i < trace->event_count; ++i) {
+                events.push_back(trace->events[i % TRACE_BUFFER_SIZE]);
+            }
+        }
+        if (events.empty()) {
+            continue;
+        }
+
+        out << (is_first ? "\n"s : ",\n"s) << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"s
+            << trace->thread_number << ",\"args\":{\"name\":\"thread "s << trace->thread_number << "\"}}"s;
+        is_first = false;
+        //Глубина областей, начало которых попало в буфер
+        size_t depth = 0;
+        for (const TraceEvent& event : events) {
+            if (!event.is_begin && depth == 0) {
+                continue;
+            }
+            depth = event.is_begin ? depth + 1 : depth - 1;
+            out << ",\n{\"name\":"s;
+            WriteJsonString(out, event.name.GetView());
+            out << ",\"ph\":\""s << (event.is_begin ? 'B' : 'E') << "\",\"ts\":"s;
+            WriteTimestamp(out, event.time_ns - registry.start_time_ns);
+            out << ",\"pid\":1,\"tid\":"s << trace->thread_number << '}';
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n"s;
+}
+
+void SaveTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Can't create trace "s + path);
+    }
+    WriteTrace(out);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+
+//Трассировка: области (LOG_TRACE, LOG_DURATION) записывают события начала и конца в кольцевой буфер
+//своего потока, WriteTrace выгружает их в формате Chrome trace events (chrome://tracing, ui.perfetto.dev).
+//Выключенная трассировка стоит одной проверки флага на область; со SEARCH_SERVER_NO_TRACING
+//области не компилируются совсем
+
+//Событий в буфере потока; старые события затираются новыми
+const size_t TRACE_BUFFER_SIZE = 16384;
+//Длина имени события вместе с завершающим нулём - длинные имена обрезаются
+const size_t TRACE_NAME_SIZE = 32;
+
+//Имя события хранится в самом событии: копия не зависит от времени жизни исходной строки
+class TraceName {
+public:
+    TraceName() = default;
+    explicit TraceName(std::string_view name);
+
+    std::string_view GetView() const;
+    bool IsEmpty() const;
+
+private:
+    char text_[TRACE_NAME_SIZE] = {};
+    uint8_t size_ = 0;
+};
+
+//Запускаем запись (буферы всех потоков очищаются, время событий отсчитывается от запуска) и останавливаем её
+void StartTracing();
+void StopTracing();
+bool IsTracingEnabled();
+
+//Начало и конец области текущего потока. Каждому TraceBegin должен соответствовать TraceEnd
+//в том же потоке, даже если запись за это время остановили
+void TraceBegin(std::string_view name);
+void TraceEnd();
+
+//Имя самой вложенной открытой области текущего потока (пустое, если открытых нет)
+std::string_view GetTraceScopeName();
+
+//События всех потоков в формате JSON. Концы, начало которых затёрто, отбрасываются;
+//начала без конца (область ещё открыта) Chrome показывает до конца трассы
+void WriteTrace(std::ostream& out);
+void SaveTrace(const std::string& path);